@@ -0,0 +1,100 @@
+#include "aabb.h"
+
+#include <algorithm>
+#include <limits>
+
+// See the header file for documentation.
+
+AABB::AABB()
+    : minimum_(std::numeric_limits<Real>::infinity(),
+               std::numeric_limits<Real>::infinity(),
+               std::numeric_limits<Real>::infinity()),
+      maximum_(-std::numeric_limits<Real>::infinity(),
+               -std::numeric_limits<Real>::infinity(),
+               -std::numeric_limits<Real>::infinity()) {}
+
+Point3 AABB::min() const { return minimum_; }
+
+Point3 AABB::max() const { return maximum_; }
+
+Point3 AABB::centroid() const { return 0.5 * (minimum_ + maximum_); }
+
+double AABB::surface_area() const {
+  Vec3 d = maximum_ - minimum_;
+  if (d.x() < 0 || d.y() < 0 || d.z() < 0) {
+    return 0.0;
+  }
+  return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+int AABB::longest_axis() const {
+  Vec3 d = maximum_ - minimum_;
+  if (d.x() > d.y() && d.x() > d.z()) {
+    return 0;
+  }
+  return d.y() > d.z() ? 1 : 2;
+}
+
+void AABB::expand(const AABB& box) {
+  for (int axis = 0; axis < 3; axis++) {
+    minimum_[axis] = std::min(minimum_[axis], box.minimum_[axis]);
+    maximum_[axis] = std::max(maximum_[axis], box.maximum_[axis]);
+  }
+}
+
+void AABB::expand(const Point3& p) {
+  for (int axis = 0; axis < 3; axis++) {
+    minimum_[axis] = std::min(minimum_[axis], p[axis]);
+    maximum_[axis] = std::max(maximum_[axis], p[axis]);
+  }
+}
+
+bool AABB::hit(const Point3& origin, const Vec3& inverse_direction,
+               Real t_min, Real t_max) const {
+  for (int axis = 0; axis < 3; axis++) {
+    Real t0 = (minimum_[axis] - origin[axis]) * inverse_direction[axis];
+    Real t1 = (maximum_[axis] - origin[axis]) * inverse_direction[axis];
+    if (inverse_direction[axis] < 0.0) {
+      std::swap(t0, t1);
+    }
+    t_min = t0 > t_min ? t0 : t_min;
+    t_max = t1 < t_max ? t1 : t_max;
+    if (t_max < t_min) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int AABB::hit(const RayPacket& packet, Real t_min) const {
+  // The lanes are the innermost loop so the compiler can keep each of
+  // these arrays in SIMD registers.
+  Real near[kPacketSize];
+  Real far[kPacketSize];
+  for (int lane = 0; lane < kPacketSize; lane++) {
+    near[lane] = t_min;
+    far[lane] = packet.t_max[lane];
+  }
+  for (int axis = 0; axis < 3; axis++) {
+    for (int lane = 0; lane < kPacketSize; lane++) {
+      Real t0 = (minimum_[axis] - packet.origin[axis][lane]) *
+                  packet.inverse_direction[axis][lane];
+      Real t1 = (maximum_[axis] - packet.origin[axis][lane]) *
+                  packet.inverse_direction[axis][lane];
+      Real low = t0 < t1 ? t0 : t1;
+      Real high = t0 < t1 ? t1 : t0;
+      near[lane] = low > near[lane] ? low : near[lane];
+      far[lane] = high < far[lane] ? high : far[lane];
+    }
+  }
+  int mask = 0;
+  for (int lane = 0; lane < kPacketSize; lane++) {
+    mask |= int(near[lane] <= far[lane]) << lane;
+  }
+  return mask;
+}
+
+std::ostream& operator<<(std::ostream& out, const AABB& box) {
+  out << "AABB(min=" << box.min() << ", max=" << box.max() << ")";
+  return out;
+}
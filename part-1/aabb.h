@@ -0,0 +1,88 @@
+#ifndef _AABB_H_
+#define _AABB_H_
+
+#include <iostream>
+
+#include "ray.h"
+#include "ray_packet.h"
+#include "vec3.h"
+
+/// An axis-aligned bounding box (AABB) is the box with faces parallel to the
+/// x, y, and z axes which tightly encloses an object. Testing a ray against a
+/// box is much cheaper than testing it against the objects inside the box
+/// so boxes are used to quickly skip over objects a ray cannot hit.
+/// See [Bounding volume](https://en.wikipedia.org/wiki/Bounding_volume).
+/// An AABB that is default constructed is empty; it encloses nothing and
+/// grows to enclose whatever is added to it.
+class AABB {
+ private:
+  /// The corner of the box with the smallest x, y, and z values
+  Point3 minimum_;
+  /// The corner of the box with the largest x, y, and z values
+  Point3 maximum_;
+
+ public:
+  /// Construct an empty box
+  AABB();
+
+  /// Construct a box given its two opposite corners
+  /// \param minimum The corner with the smallest x, y, and z values
+  /// \param maximum The corner with the largest x, y, and z values
+  AABB(const Point3& minimum, const Point3& maximum)
+      : minimum_(minimum), maximum_(maximum){};
+
+  /// Return the corner of the box with the smallest x, y, and z values
+  Point3 min() const;
+
+  /// Return the corner of the box with the largest x, y, and z values
+  Point3 max() const;
+
+  /// Return the point halfway between the box's corners
+  Point3 centroid() const;
+
+  /// Return the total area of the box's six faces.
+  /// The surface area is proportional to the chance that a random ray
+  /// strikes the box.
+  /// \returns The surface area, 0 for an empty box
+  double surface_area() const;
+
+  /// Return the axis (0 for x, 1 for y, 2 for z) along which the box is
+  /// longest
+  int longest_axis() const;
+
+  /// Grow the box so that it also encloses \p box
+  /// \param box The box to enclose
+  void expand(const AABB& box);
+
+  /// Grow the box so that it also encloses the point \p p
+  /// \param p The point to enclose
+  void expand(const Point3& p);
+
+  /// Check if the ray strikes the box between \p t_min and \p t_max.
+  /// This is the slab test; the ray is clipped against the pair of planes
+  /// on each axis. The reciprocal of the ray's direction is passed in
+  /// because it is the same for every box the ray is tested against.
+  /// \param origin The ray's origin
+  /// \param inverse_direction 1 / direction for each component of the ray
+  /// \param t_min The minimum value of the interval to test
+  /// \param t_max The maximum value of the interval to test
+  /// \returns true if the ray strikes the box in the interval else false
+  bool hit(const Point3& origin, const Vec3& inverse_direction, Real t_min,
+           Real t_max) const;
+
+  /// Check which rays of \p packet strike the box between \p t_min and
+  /// the ray's own t_max. The box is loaded once and clipped against every
+  /// lane of the packet together.
+  /// \param packet The rays to test
+  /// \param t_min The minimum value of the interval to test
+  /// \returns A bit mask with bit i set if the ray in lane i strikes the box
+  int hit(const RayPacket& packet, Real t_min) const;
+};
+
+/// Output a box to an ostream
+/// \param out An output stream such as cout
+/// \param box A box
+/// \returns An output stream (it returns out)
+std::ostream& operator<<(std::ostream& out, const AABB& box);
+
+#endif
@@ -0,0 +1,288 @@
+// Render benchmark suite
+//
+// Renders a fixed set of deterministic scenes (1, 100, 10k, and 100k
+// spheres) at several resolutions and sample counts and reports rays per
+// second. Each case is rendered twice, once only intersecting the rays with
+// the world and once shading them, to split the time between finding hits
+// and shading them. The results can be saved as JSON and CSV so runs from
+// different commits can be compared. --accel picks the structure the rays
+// are traced through: the BVH, the linear BVH, the uniform grid, or a
+// linear scan which tests every ray against every sphere.
+//
+//   make bench
+//   ./rt_bench --json bench.json --csv bench.csv --label "$(git describe)"
+//   ./rt_bench --quick --accel grid
+//
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "grid.h"
+#include "parallel.h"
+#include "render.h"
+#include "rng.h"
+#include "utility.h"
+
+using namespace std;
+
+namespace {
+// Every scene and every image is generated from this seed so that runs on
+// different commits trace exactly the same rays.
+const uint64_t kBenchSeed = 20210506;
+
+struct BenchScene {
+  string name;
+  // The number of random spheres, or 0 for the one sphere OriginalScene()
+  int num_random;
+  // Large scenes are skipped with --quick
+  bool quick;
+};
+
+struct BenchCase {
+  int width;
+  int height;
+  int samples_per_pixel;
+  bool quick;
+};
+
+struct Result {
+  string scene;
+  string accel;
+  int spheres;
+  int width;
+  int height;
+  int samples_per_pixel;
+  int threads;
+  long long rays;
+  double build_seconds;
+  double total_seconds;
+  double intersect_seconds;
+  double shade_seconds;
+  double rays_per_second;
+};
+
+const vector<BenchScene> kScenes{{"original", 0, true},
+                                 {"random_100", 100, true},
+                                 {"random_10k", 10000, true},
+                                 {"random_100k", 100000, false}};
+
+const vector<BenchCase> kCases{{320, 180, 1, true},
+                               {320, 180, 16, true},
+                               {1280, 720, 1, false},
+                               {1280, 720, 4, false}};
+
+struct BenchOptions {
+  string json_file_name;
+  string csv_file_name;
+  string label;
+  // The structure built over each scene: bvh, lbvh, grid, or linear
+  string accel = "bvh";
+  int threads = 0;
+  int repeat = 1;
+  bool quick = false;
+  // Trace camera rays one at a time instead of in packets
+  bool no_packets = false;
+  // Shade without tracing shadow rays
+  bool no_shadows = false;
+};
+
+double Seconds(chrono::steady_clock::time_point start,
+               chrono::steady_clock::time_point end) {
+  return chrono::duration<double>(end - start).count();
+}
+
+// Build a scene without printing the world definition.
+vector<shared_ptr<Hittable>> MakeScene(const BenchScene& scene) {
+  SeedRandom(kBenchSeed);
+  return scene.num_random > 0 ? RandomScene(scene.num_random)
+                              : OriginalScene();
+}
+
+// Build the structure called accel over the objects of a scene.
+unique_ptr<Hittable> BuildWorld(const string& accel,
+                                vector<shared_ptr<Hittable>> objects,
+                                int threads) {
+  if (accel == "grid") {
+    return make_unique<Grid>(move(objects), threads);
+  }
+  if (accel == "bvh") {
+    return make_unique<BVH>(move(objects));
+  }
+  // Every scene is made of spheres; a SphereSet tests them all.
+  auto spheres = make_unique<SphereSet>();
+  for (const auto& object : objects) {
+    spheres->add(*static_pointer_cast<Sphere>(object));
+  }
+  if (accel == "lbvh") {
+    return make_unique<BVH>(*spheres, BVH::Builder::kLinear, threads);
+  }
+  return spheres;
+}
+
+// Render the case repeat times and return the fastest time.
+double TimeRender(const Hittable& world, const RenderSettings& settings,
+                  int repeat) {
+  double best = 0.0;
+  for (int i = 0; i < repeat; i++) {
+    auto start = chrono::steady_clock::now();
+    auto framebuffer = Render(world, settings);
+    double seconds = Seconds(start, chrono::steady_clock::now());
+    best = i == 0 ? seconds : min(best, seconds);
+  }
+  return best;
+}
+
+void WriteJson(const string& file_name, const string& label,
+               const vector<Result>& results) {
+  ofstream out(file_name);
+  out << "{\n  \"label\": \"" << label << "\",\n  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    out << "    {\"scene\": \"" << r.scene << "\", \"accel\": \"" << r.accel
+        << "\", \"spheres\": " << r.spheres
+        << ", \"width\": " << r.width << ", \"height\": " << r.height
+        << ", \"spp\": " << r.samples_per_pixel
+        << ", \"threads\": " << r.threads << ", \"rays\": " << r.rays
+        << ", \"build_seconds\": " << r.build_seconds
+        << ", \"total_seconds\": " << r.total_seconds
+        << ", \"intersect_seconds\": " << r.intersect_seconds
+        << ", \"shade_seconds\": " << r.shade_seconds
+        << ", \"rays_per_second\": " << r.rays_per_second << "}"
+        << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+}
+
+void WriteCsv(const string& file_name, const string& label,
+              const vector<Result>& results) {
+  ofstream out(file_name);
+  out << "label,scene,accel,spheres,width,height,spp,threads,rays,"
+         "build_seconds,total_seconds,intersect_seconds,shade_seconds,"
+         "rays_per_second\n";
+  for (const Result& r : results) {
+    out << label << "," << r.scene << "," << r.accel << "," << r.spheres
+        << "," << r.width << "," << r.height << "," << r.samples_per_pixel
+        << "," << r.threads << "," << r.rays << "," << r.build_seconds << ","
+        << r.total_seconds << "," << r.intersect_seconds << ","
+        << r.shade_seconds << "," << r.rays_per_second << "\n";
+  }
+}
+
+bool ParseBenchOptions(int argc, char const* argv[], BenchOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    string argument{argv[i]};
+    bool has_value = i + 1 < argc;
+    if (argument == "--json" && has_value) {
+      options.json_file_name = argv[++i];
+    } else if (argument == "--csv" && has_value) {
+      options.csv_file_name = argv[++i];
+    } else if (argument == "--label" && has_value) {
+      options.label = argv[++i];
+    } else if (argument == "--accel" && has_value) {
+      options.accel = argv[++i];
+      if (options.accel != "bvh" && options.accel != "lbvh" &&
+          options.accel != "grid" && options.accel != "linear") {
+        return false;
+      }
+    } else if (argument == "--threads" && has_value) {
+      options.threads = max(0, atoi(argv[++i]));
+    } else if (argument == "--repeat" && has_value) {
+      options.repeat = max(1, atoi(argv[++i]));
+    } else if (argument == "--quick") {
+      options.quick = true;
+    } else if (argument == "--no-packets") {
+      options.no_packets = true;
+    } else if (argument == "--no-shadows") {
+      options.no_shadows = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  BenchOptions options;
+  if (!ParseBenchOptions(argc, argv, options)) {
+    cout << "Usage: " << argv[0] << " [--json FILE] [--csv FILE]"
+         << " [--label TEXT] [--accel bvh|lbvh|grid|linear] [--threads N]"
+         << " [--repeat N] [--quick]"
+         << " [--no-packets] [--no-shadows]\n";
+    return 1;
+  }
+  cout << left << setw(12) << "scene" << setw(9) << "spheres" << setw(11)
+       << "size" << setw(5) << "spp" << right << setw(10) << "build(s)"
+       << setw(10) << "total(s)" << setw(10) << "isect(s)" << setw(10)
+       << "shade(s)" << setw(10) << "Mrays/s"
+       << "\n";
+  vector<Result> results;
+  for (const BenchScene& scene : kScenes) {
+    if (options.quick && !scene.quick) {
+      continue;
+    }
+    auto objects = MakeScene(scene);
+    int num_spheres = int(objects.size());
+    auto build_start = chrono::steady_clock::now();
+    unique_ptr<Hittable> world =
+        BuildWorld(options.accel, move(objects), options.threads);
+    double build_seconds = Seconds(build_start, chrono::steady_clock::now());
+    for (const BenchCase& bench_case : kCases) {
+      if (options.quick && !bench_case.quick) {
+        continue;
+      }
+      RenderSettings settings;
+      settings.width = bench_case.width;
+      settings.height = bench_case.height;
+      settings.samples_per_pixel = bench_case.samples_per_pixel;
+      settings.threads = options.threads;
+      settings.seed = kBenchSeed;
+      settings.packets = !options.no_packets;
+      settings.shadows = !options.no_shadows;
+      Result result;
+      result.scene = scene.name;
+      result.accel = options.accel;
+      result.spheres = num_spheres;
+      result.width = settings.width;
+      result.height = settings.height;
+      result.samples_per_pixel = settings.samples_per_pixel;
+      result.threads = ThreadCount(options.threads);
+      result.rays = (long long)settings.width * settings.height *
+                    settings.samples_per_pixel;
+      result.build_seconds = build_seconds;
+      result.total_seconds = TimeRender(*world, settings, options.repeat);
+      settings.shade = false;
+      result.intersect_seconds = TimeRender(*world, settings, options.repeat);
+      result.shade_seconds =
+          max(0.0, result.total_seconds - result.intersect_seconds);
+      result.rays_per_second = double(result.rays) / result.total_seconds;
+      results.push_back(result);
+
+      ostringstream size;
+      size << result.width << "x" << result.height;
+      cout << left << setw(12) << result.scene << setw(9) << result.spheres
+           << setw(11) << size.str() << setw(5) << result.samples_per_pixel
+           << right << fixed << setprecision(3) << setw(10)
+           << result.build_seconds << setw(10) << result.total_seconds
+           << setw(10) << result.intersect_seconds << setw(10)
+           << result.shade_seconds << setw(10) << setprecision(2)
+           << result.rays_per_second / 1e6 << "\n"
+           << defaultfloat;
+    }
+  }
+  if (!options.json_file_name.empty()) {
+    WriteJson(options.json_file_name, options.label, results);
+  }
+  if (!options.csv_file_name.empty()) {
+    WriteCsv(options.csv_file_name, options.label, results);
+  }
+  return 0;
+}
@@ -0,0 +1,500 @@
+// Micro-benchmarks for the ray tracer's hottest kernels
+//
+// Measures the throughput of Sphere::hit() for hit heavy and miss heavy
+// rays, the SphereSet intersection kernels, shadow rays through a BVH,
+// Vec3 arithmetic, PhongColor(), choosing the lights for a point, and
+// RandomDouble01() in isolation so that an optimization of one of them can
+// be measured on its own. It also checks that the specular highlight
+// tables are accurate enough to stand in for std::pow() and that every
+// SphereSet kernel finds the same hits as the scalar one, and exits with
+// status 1 if either check fails.
+//
+//   make microbench
+//   ./rt_microbench [--filter TEXT] [--min-time SECONDS]
+//
+// Each benchmark runs in a loop, doubling the number of iterations until a
+// run takes at least the minimum time, and reports millions of operations
+// per second and nanoseconds per operation.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bvh.h"
+#include "light.h"
+#include "material.h"
+#include "ray_packet.h"
+#include "render.h"
+#include "rng.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "utility.h"
+#include "vec3.h"
+
+using namespace std;
+
+namespace {
+// Keep the compiler from optimizing away a value that is never used.
+template <typename T>
+void DoNotOptimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// A benchmark runs its body iterations times; each iteration performs
+// operations_per_iteration operations.
+struct Benchmark {
+  string name;
+  long operations_per_iteration;
+  function<void(long iterations)> body;
+};
+
+double MinTime = 0.25;
+
+void Run(const Benchmark& benchmark) {
+  long iterations = 1;
+  double seconds = 0.0;
+  while (true) {
+    auto start = chrono::steady_clock::now();
+    benchmark.body(iterations);
+    seconds =
+        chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    if (seconds >= MinTime || iterations >= (1L << 40)) {
+      break;
+    }
+    iterations *= 2;
+  }
+  double operations = double(iterations) * benchmark.operations_per_iteration;
+  cout << left << setw(34) << benchmark.name << right << fixed
+       << setprecision(2) << setw(12) << operations / seconds / 1e6
+       << " M/s" << setw(12) << seconds / operations * 1e9 << " ns/op\n"
+       << defaultfloat;
+}
+
+const int kNumRays = 1024;
+
+// Rays from the origin aimed at points scattered around target. A spread
+// of 0 aims every ray right at target.
+vector<Ray> MakeRays(const Point3& target, double spread) {
+  vector<Ray> rays;
+  rays.reserve(kNumRays);
+  for (int i = 0; i < kNumRays; i++) {
+    Vec3 offset = spread * Vec3::random_11();
+    rays.emplace_back(Point3{0, 0, 0}, target + offset);
+  }
+  return rays;
+}
+
+vector<Benchmark> MakeBenchmarks() {
+  vector<Benchmark> benchmarks;
+  auto material = make_shared<PhongMaterial>(
+      Color{0.3, 0.3, 0.0}, Color{0.7, 0.7, 0.0}, Color{0.5, 0.5, 0.0}, 32.0);
+  auto sphere = make_shared<Sphere>(Point3{0, 0, -5}, 1.0, material);
+  auto hit_rays = make_shared<vector<Ray>>(MakeRays(Point3{0, 0, -5}, 0.5));
+  auto miss_rays = make_shared<vector<Ray>>(MakeRays(Point3{0, 0, -5}, 8.0));
+  auto hit_records = make_shared<vector<HitRecord>>();
+  for (const Ray& r : *hit_rays) {
+    HitRecord rec;
+    if (sphere->hit(r, 0.0, kInfinity, rec)) {
+      hit_records->push_back(rec);
+    }
+  }
+
+  auto sphere_hit = [sphere](shared_ptr<vector<Ray>> rays) {
+    return [sphere, rays](long iterations) {
+      HitRecord rec;
+      for (long i = 0; i < iterations; i++) {
+        for (const Ray& r : *rays) {
+          bool hit = sphere->hit(r, 0.0, kInfinity, rec);
+          DoNotOptimize(hit);
+        }
+      }
+    };
+  };
+  benchmarks.push_back({"Sphere::hit (hits)", kNumRays, sphere_hit(hit_rays)});
+  benchmarks.push_back(
+      {"Sphere::hit (misses)", kNumRays, sphere_hit(miss_rays)});
+
+  // A SphereSet of 64 spheres in front of the camera; every call tests a
+  // ray against all of them.
+  auto spheres = make_shared<SphereSet>();
+  for (int i = 0; i < 64; i++) {
+    spheres->add(Point3{RandomDouble(-4, 4), RandomDouble(-2, 2),
+                        RandomDouble(-10, -4)},
+                 0.25, material->id());
+  }
+  for (string kernel : {"scalar", "sse2", "avx2"}) {
+    if (!SphereSet::select_kernel(kernel)) {
+      continue;
+    }
+    benchmarks.push_back(
+        {"SphereSet::hit x64 (" + kernel + ")", 64L * kNumRays,
+         [spheres, miss_rays, kernel](long iterations) {
+           SphereSet::select_kernel(kernel);
+           HitRecord rec;
+           for (long i = 0; i < iterations; i++) {
+             for (const Ray& r : *miss_rays) {
+               bool hit = spheres->hit(r, 0.0, kInfinity, rec);
+               DoNotOptimize(hit);
+             }
+           }
+         }});
+  }
+
+  // Shadow rays through a BVH over 10,000 small spheres, from points below
+  // the spheres toward a light above them. Most rays are blocked; hit()
+  // goes on to find the closest blocker where occluded() stops at the
+  // first.
+  SphereSet cloud;
+  for (int i = 0; i < 10000; i++) {
+    cloud.add(Point3{RandomDouble(-20, 20), RandomDouble(0, 10),
+                     RandomDouble(-20, 20)},
+              0.3, material->id());
+  }
+  auto bvh = make_shared<BVH>(cloud);
+  auto shadow_rays = make_shared<vector<Ray>>();
+  for (int i = 0; i < kNumRays; i++) {
+    Point3 from{RandomDouble(-20, 20), -1, RandomDouble(-20, 20)};
+    shadow_rays->emplace_back(from, Point3{0, 50, 0} - from);
+  }
+  benchmarks.push_back({"BVH::hit (shadow rays)", kNumRays,
+                        [bvh, shadow_rays](long n) {
+                          HitRecord rec;
+                          for (long i = 0; i < n; i++) {
+                            for (const Ray& r : *shadow_rays) {
+                              bool hit = bvh->hit(r, 0.0, 1.0, rec);
+                              DoNotOptimize(hit);
+                            }
+                          }
+                        }});
+  benchmarks.push_back({"BVH::occluded (shadow rays)", kNumRays,
+                        [bvh, shadow_rays](long n) {
+                          for (long i = 0; i < n; i++) {
+                            for (const Ray& r : *shadow_rays) {
+                              bool hit = bvh->occluded(r, 1.0);
+                              DoNotOptimize(hit);
+                            }
+                          }
+                        }});
+
+  auto vectors = make_shared<vector<Vec3>>();
+  for (int i = 0; i < kNumRays; i++) {
+    vectors->push_back(Vec3::random_11());
+  }
+  benchmarks.push_back({"Vec3 u + v * t", kNumRays, [vectors](long n) {
+                          for (long i = 0; i < n; i++) {
+                            Vec3 sum;
+                            for (const Vec3& v : *vectors) {
+                              sum += v + v * 0.5;
+                            }
+                            DoNotOptimize(sum);
+                          }
+                        }});
+  benchmarks.push_back({"Vec3 Dot", kNumRays, [vectors](long n) {
+                          for (long i = 0; i < n; i++) {
+                            for (const Vec3& v : *vectors) {
+                              double d = Dot(v, v);
+                              DoNotOptimize(d);
+                            }
+                          }
+                        }});
+  benchmarks.push_back({"Vec3 Cross", kNumRays, [vectors](long n) {
+                          Vec3 up{0, 1, 0};
+                          for (long i = 0; i < n; i++) {
+                            for (const Vec3& v : *vectors) {
+                              Vec3 c = Cross(v, up);
+                              DoNotOptimize(c);
+                            }
+                          }
+                        }});
+  benchmarks.push_back({"Vec3 UnitVector", kNumRays, [vectors](long n) {
+                          for (long i = 0; i < n; i++) {
+                            for (const Vec3& v : *vectors) {
+                              Vec3 u = UnitVector(v);
+                              DoNotOptimize(u);
+                            }
+                          }
+                        }});
+
+  for (bool exact : {false, true}) {
+    benchmarks.push_back(
+        {exact ? "PhongColor (std::pow)" : "PhongColor",
+         long(hit_records->size()), [hit_records, hit_rays, exact](long n) {
+           vector<LightSample> lights{
+               LightSample{Vec3{20, 20, 4}, 1, Color{1, 1, 1}}};
+           for (long i = 0; i < n; i++) {
+             for (size_t j = 0; j < hit_records->size(); j++) {
+               const HitRecord& rec = (*hit_records)[j];
+               const SpecularTable* table =
+                   exact ? nullptr
+                         : &Materials().specular_table(rec.material_id);
+               Color c = PhongColor(Materials()[rec.material_id], table,
+                                    (*hit_rays)[j], rec, lights);
+               DoNotOptimize(c);
+             }
+           }
+         }});
+  }
+
+  // Small point lights scattered over a floor whose area grows with the
+  // number of lights, so that about as many lights reach each point
+  // whatever their number. Culling keeps the cost of choosing the lights
+  // for a point flat; without it the cost grows with the number of lights.
+  auto points = make_shared<vector<Point3>>();
+  for (int i = 0; i < kNumRays; i++) {
+    points->push_back(Point3{RandomDouble(0, 1), 0, RandomDouble(0, 1)});
+  }
+  for (int count : {100, 10000}) {
+    double side = 4.0 * sqrt(double(count));
+    vector<Light> lights;
+    for (int i = 0; i < count; i++) {
+      lights.push_back(Light{Light::Type::kPoint,
+                             Point3{RandomDouble(0, side), 2,
+                                    RandomDouble(0, side)},
+                             Color{0.05, 0.05, 0.05}});
+    }
+    for (double cutoff : {1e-3, 0.0}) {
+      auto list = make_shared<LightList>(lights, cutoff, 8);
+      benchmarks.push_back(
+          {"Lights for a point (" + to_string(count) +
+               (cutoff > 0 ? ")" : ", no cull)"),
+           kNumRays, [list, points, side](long n) {
+             vector<LightSample> samples;
+             for (long i = 0; i < n; i++) {
+               for (const Point3& p : *points) {
+                 list->sample(side * p, samples);
+                 DoNotOptimize(samples.size());
+               }
+             }
+           }});
+    }
+  }
+
+  benchmarks.push_back({"RandomDouble01", kNumRays, [](long n) {
+                          for (long i = 0; i < n; i++) {
+                            for (int j = 0; j < kNumRays; j++) {
+                              double d = RandomDouble01();
+                              DoNotOptimize(d);
+                            }
+                          }
+                        }});
+  return benchmarks;
+}
+
+// What one kernel finds for one ray against a range of a SphereSet: the
+// closest hit, whether the ray is blocked, and, for the packet the ray is
+// a lane of, the index and distance of the sphere struck.
+struct KernelResult {
+  bool hit = false;
+  Real t = 0;
+  Point3 p;
+  Vec3 normal;
+  int material_id = -1;
+  bool occluded = false;
+  int closest = -1;
+  Real packet_t = 0;
+
+  bool operator==(const KernelResult& other) const {
+    return hit == other.hit && occluded == other.occluded &&
+           closest == other.closest && packet_t == other.packet_t &&
+           (!hit || (t == other.t && material_id == other.material_id &&
+                     p.x() == other.p.x() && p.y() == other.p.y() &&
+                     p.z() == other.p.z() &&
+                     normal.x() == other.normal.x() &&
+                     normal.y() == other.normal.y() &&
+                     normal.z() == other.normal.z()));
+  }
+};
+
+// Trace rays against ranges of spheres with the kernel in use. The ranges
+// start and end at every offset from a SIMD batch so that the partial
+// batches at both ends are tested.
+vector<KernelResult> TraceKernel(const SphereSet& spheres,
+                                 const vector<Ray>& rays) {
+  vector<KernelResult> results;
+  for (int first = 0; first < 8; first++) {
+    for (int count : {1, 3, 8, 13, spheres.size() - first}) {
+      for (size_t i = 0; i < rays.size(); i += kPacketSize) {
+        RayPacket packet;
+        for (int lane = 0; lane < kPacketSize; lane++) {
+          // Every other packet stops short so t_max is tested too.
+          Real t_max = (i / kPacketSize) % 2 == 0 ? kInfinity : Real(7);
+          packet.set(lane, rays[i + lane], t_max);
+        }
+        array<int, kPacketSize> closest;
+        closest.fill(-1);
+        spheres.hit_packet(packet, first, count, 0.001, closest.data());
+        for (int lane = 0; lane < kPacketSize; lane++) {
+          const Ray& r = rays[i + lane];
+          Real t_max = (i / kPacketSize) % 2 == 0 ? kInfinity : Real(7);
+          KernelResult result;
+          HitRecord rec;
+          result.hit = spheres.hit(r, first, count, 0.001, t_max, rec);
+          result.t = rec.t;
+          result.p = rec.p;
+          result.normal = rec.normal;
+          result.material_id = rec.material_id;
+          result.occluded = spheres.occluded(r, first, count, t_max);
+          result.closest = closest[lane];
+          result.packet_t = packet.t_max[lane];
+          results.push_back(result);
+        }
+      }
+    }
+  }
+  return results;
+}
+
+// Check that every SphereSet kernel the CPU supports finds exactly the
+// same hits as the scalar kernel, as sphere_set.h promises, and print the
+// number of rays on which any of them differs. Returns false if one does.
+bool CheckKernels() {
+  // Overlapping spheres of several sizes, with each its own material so a
+  // hit on the wrong sphere shows, and rays from around and inside them.
+  SphereSet spheres;
+  for (int i = 0; i < 45; i++) {
+    spheres.add(Point3{RandomDouble(-3, 3), RandomDouble(-3, 3),
+                       RandomDouble(-12, -4)},
+                RandomDouble(0.2, 1.5), i);
+  }
+  vector<Ray> rays;
+  for (int i = 0; i < 4000; i++) {
+    Point3 from = i % 4 == 0 ? spheres.center(i % spheres.size())
+                             : Point3{RandomDouble(-1, 1),
+                                      RandomDouble(-1, 1), 0};
+    Point3 to{RandomDouble(-4, 4), RandomDouble(-4, 4),
+              RandomDouble(-13, -3)};
+    rays.emplace_back(from, to - from);
+  }
+  string default_kernel = SphereSet::kernel_name();
+  SphereSet::select_kernel("scalar");
+  vector<KernelResult> expected = TraceKernel(spheres, rays);
+  long mismatches = 0;
+  string checked = "scalar";
+  for (string kernel : {"sse2", "avx2"}) {
+    if (!SphereSet::select_kernel(kernel)) {
+      continue;
+    }
+    checked += ", " + kernel;
+    vector<KernelResult> results = TraceKernel(spheres, rays);
+    for (size_t i = 0; i < results.size(); i++) {
+      if (!(results[i] == expected[i])) {
+        if (mismatches == 0) {
+          cerr << "The " << kernel << " kernel differs from the scalar one"
+               << " on ray " << i % rays.size() << "\n";
+        }
+        mismatches++;
+      }
+    }
+  }
+  SphereSet::select_kernel(default_kernel);
+  cout << left << setw(34) << "SphereSet kernels vs scalar" << right
+       << setw(12) << mismatches << " mismatches (" << checked << ")\n";
+  return mismatches == 0;
+}
+
+// The 8 bit level Image::write_framebuffer() writes for a linear channel.
+long Level(double linear) {
+  return lround(255.0 * sqrt(min(max(linear, 0.0), 1.0)));
+}
+
+// Compare each material's SpecularTable with std::pow(), then an image of
+// a random scene shaded with the tables with the same image shaded with
+// std::pow(), and print the largest errors. Returns false if a table is
+// further from std::pow() than the bound documented in SpecularTable or
+// the images differ by more than one level in any channel.
+bool ReportSpecularError() {
+  const long kMaxLevels = 1;
+  double table_bound = log(SpecularTable::kCutoff) *
+                       log(SpecularTable::kCutoff) /
+                       (8.0 * SpecularTable::kSize * SpecularTable::kSize);
+  double table_error = 0.0;
+  for (const auto& material : make_phong_material_array()) {
+    double shininess = material->shininess();
+    SpecularTable table{shininess};
+    for (int i = 0; i <= 100000; i++) {
+      double x = i / 100000.0;
+      double error = abs(double(table(Real(x))) - pow(x, shininess));
+      table_error = max(table_error, error);
+    }
+  }
+  cout << left << setw(34) << "Specular table vs std::pow" << right
+       << setw(12) << setprecision(2) << table_error << " max error\n";
+
+  SeedRandom(1);
+  BVH world{RandomScene(100)};
+  RenderSettings settings;
+  settings.width = 320;
+  settings.height = 180;
+  settings.samples_per_pixel = 4;
+  settings.seed = 1;
+  vector<Color> table_image = Render(world, settings);
+  settings.exact_specular = true;
+  vector<Color> exact_image = Render(world, settings);
+  long max_levels = 0;
+  long differing = 0;
+  for (size_t i = 0; i < table_image.size(); i++) {
+    for (int channel = 0; channel < 3; channel++) {
+      long levels = labs(Level(table_image[i][channel]) -
+                         Level(exact_image[i][channel]));
+      max_levels = max(max_levels, levels);
+      differing += levels > 0 ? 1 : 0;
+    }
+  }
+  cout << left << setw(34) << "  image shaded with it" << right << setw(12)
+       << max_levels << " max levels, " << differing << " of "
+       << 3 * table_image.size() << " channels differ\n"
+       << defaultfloat;
+  bool passed = true;
+  if (table_error > table_bound) {
+    cerr << "Specular table error " << table_error << " exceeds the bound "
+         << table_bound << "\n";
+    passed = false;
+  }
+  if (max_levels > kMaxLevels) {
+    cerr << "Image shaded with the specular tables differs by "
+         << max_levels << " levels, more than " << kMaxLevels << "\n";
+    passed = false;
+  }
+  return passed;
+}
+}  // namespace
+
+int main(int argc, char const* argv[]) {
+  string filter;
+  for (int i = 1; i < argc; i++) {
+    string argument{argv[i]};
+    if (argument == "--filter" && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (argument == "--min-time" && i + 1 < argc) {
+      MinTime = atof(argv[++i]);
+    } else {
+      cout << "Usage: " << argv[0]
+           << " [--filter TEXT] [--min-time SECONDS]\n";
+      return 1;
+    }
+  }
+  SeedRandom(1);
+  string default_kernel = SphereSet::kernel_name();
+  for (const Benchmark& benchmark : MakeBenchmarks()) {
+    if (benchmark.name.find(filter) != string::npos) {
+      Run(benchmark);
+    }
+  }
+  SphereSet::select_kernel(default_kernel);
+  bool passed = true;
+  if (string("SphereSet kernels vs scalar").find(filter) != string::npos) {
+    passed = CheckKernels() && passed;
+  }
+  if (string("Specular table vs std::pow").find(filter) != string::npos) {
+    passed = ReportSpecularError() && passed;
+  }
+  return passed ? 0 : 1;
+}
@@ -0,0 +1,708 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include "parallel.h"
+#include "stats.h"
+
+// See the header file for documentation.
+
+namespace {
+// The number of buckets the centroids are sorted into when searching for
+// the cheapest split along an axis.
+const int kNumBins = 16;
+// The cost of visiting an interior node relative to testing one object.
+const double kTraversalCost = 0.125;
+// The traversal stack in BVH::hit() holds one entry for each level above
+// the node being visited, so no tree may be deeper than kStackSize. Past
+// MaxSahDepth() the builder stops using the SAH and splits at the median.
+const int kMaxSahDepth = 48;
+const int kStackSize = 64;
+// The number of packed spheres tested by one batch, an AVX2 register full,
+// and the largest leaf built over packed spheres.
+const int kBatchSize = 32 / sizeof(Real);
+const int kMaxPackedLeafSize = 8;
+
+struct Bin {
+  AABB bounds;
+  int count = 0;
+};
+
+// The depth past which a tree over count objects is split at the median.
+// Halving a node of at most count objects reaches single objects within
+// ceil(log2(count)) levels, so the tree is at most kStackSize deep.
+int MaxSahDepth(std::size_t count) {
+  int levels = 0;
+  while ((std::size_t(1) << levels) < count) {
+    levels++;
+  }
+  return std::min(kMaxSahDepth, kStackSize - levels);
+}
+
+// The largest leaf of a linear BVH.
+const int kMaxLinearLeafSize = 4;
+// The number of spheres handed to a thread at a time while building a
+// linear BVH, and the size of the subtrees built on their own threads.
+const int kLinearBlockSize = 16384;
+// The number of bits of a key sorted by each pass of RadixSort().
+const int kRadixBits = 8;
+const int kRadixSize = 1 << kRadixBits;
+
+// Spread the low 21 bits of x out to every third bit.
+std::uint64_t SpreadBits(std::uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+// The Morton code of the cell (x, y, z): their bits interleaved, x's
+// highest. Bit b of the code is a bit of x, y or z as b % 3 is 2, 1 or 0.
+std::uint64_t MortonCode(std::uint64_t x, std::uint64_t y, std::uint64_t z) {
+  return SpreadBits(x) << 2 | SpreadBits(y) << 1 | SpreadBits(z);
+}
+
+// Sort keys by their bits from low_bit up to high_bit, exclusive, with a
+// least significant digit radix sort; keys which tie keep their order.
+// Each pass is a stable counting sort by kRadixBits bits. The keys are
+// split into one run per thread, each thread counts the digits of its run,
+// and the counts tell each thread where to write its run's keys.
+void RadixSort(std::vector<std::uint64_t>& keys, int low_bit, int high_bit,
+               int threads) {
+  int n = int(keys.size());
+  int num_runs = std::max(1, std::min(ThreadCount(threads), n / 4096));
+  std::vector<std::uint64_t> sorted(n);
+  std::vector<std::array<int, kRadixSize>> counts(num_runs);
+  auto run_begin = [&](int run) {
+    return int(std::int64_t(n) * run / num_runs);
+  };
+  for (int shift = low_bit; shift < high_bit; shift += kRadixBits) {
+    auto digit = [shift](std::uint64_t key) {
+      return int(key >> shift) & (kRadixSize - 1);
+    };
+    ParallelFor(num_runs, threads, 1, [&](int run, int /*end*/) {
+      counts[run].fill(0);
+      for (int i = run_begin(run); i < run_begin(run + 1); i++) {
+        counts[run][digit(keys[i])]++;
+      }
+    });
+    // When every key has the same digit there is nothing to sort.
+    int same = 0;
+    for (int run = 0; run < num_runs; run++) {
+      same += counts[run][digit(keys[0])];
+    }
+    if (same == n) {
+      continue;
+    }
+    int total = 0;
+    for (int d = 0; d < kRadixSize; d++) {
+      for (int run = 0; run < num_runs; run++) {
+        int count = counts[run][d];
+        counts[run][d] = total;
+        total += count;
+      }
+    }
+    ParallelFor(num_runs, threads, 1, [&](int run, int /*end*/) {
+      std::array<int, kRadixSize>& next = counts[run];
+      for (int i = run_begin(run); i < run_begin(run + 1); i++) {
+        sorted[next[digit(keys[i])]++] = keys[i];
+      }
+    });
+    keys.swap(sorted);
+  }
+}
+
+// Find where to split the keys [begin, end), sorted, of a linear BVH: at
+// the first key whose code has a 1 in the highest bit in which the codes
+// differ. Sets mid to the first key of the second half and returns the
+// axis of the bit. Keys with equal codes, or a node so deep that the
+// traversal stack could overflow, are split in half.
+int LinearSplit(const std::vector<std::uint64_t>& keys, int shift,
+                int begin, int end, int depth, int& mid) {
+  std::uint64_t first = keys[begin] >> shift;
+  std::uint64_t last = keys[end - 1] >> shift;
+  if (first == last || depth >= MaxSahDepth(keys.size())) {
+    mid = begin + (end - begin) / 2;
+    return 0;
+  }
+  int bit = 63;
+  while (((first ^ last) >> bit) == 0) {
+    bit--;
+  }
+  mid = int(std::partition_point(keys.begin() + begin, keys.begin() + end,
+                                 [=](std::uint64_t key) {
+                                   return ((key >> shift >> bit) & 1) == 0;
+                                 }) -
+            keys.begin());
+  return 2 - bit % 3;
+}
+}  // namespace
+
+BVH::BVH(std::vector<std::shared_ptr<Hittable>> objects) {
+  if (objects.empty()) {
+    return;
+  }
+  std::vector<BuildItem> items;
+  items.reserve(objects.size());
+  for (std::size_t i = 0; i < objects.size(); i++) {
+    AABB bounds = objects[i]->bounding_box();
+    items.push_back(BuildItem{bounds, bounds.centroid(), int(i)});
+  }
+  // Spheres are packed into a SphereSet and tested a SIMD batch at a time,
+  // which makes bigger leaves cheaper; the builder needs to know that.
+  packed_ = std::all_of(objects.begin(), objects.end(),
+                        [](const std::shared_ptr<Hittable>& object) {
+                          return dynamic_cast<Sphere*>(object.get()) !=
+                                 nullptr;
+                        });
+  nodes_.reserve(2 * objects.size());
+  build(items, 0, int(items.size()), 0);
+  // Put the objects in leaf order so a leaf's objects are contiguous.
+  objects_.reserve(objects.size());
+  for (const auto& item : items) {
+    objects_.push_back(std::move(objects[item.index]));
+  }
+  if (packed_) {
+    for (const auto& object : objects_) {
+      spheres_.add(*std::static_pointer_cast<Sphere>(object));
+    }
+  }
+}
+
+BVH::BVH(const SphereSet& spheres, Builder builder, int threads)
+    : packed_(true) {
+  int n = spheres.size();
+  if (n == 0) {
+    return;
+  }
+  if (builder == Builder::kLinear) {
+    build_linear(spheres, threads);
+    return;
+  }
+  std::vector<BuildItem> items;
+  items.reserve(n);
+  for (int i = 0; i < n; i++) {
+    AABB bounds = spheres.bounding_box(i);
+    items.push_back(BuildItem{bounds, bounds.centroid(), i});
+  }
+  nodes_.reserve(2 * n);
+  build(items, 0, n, 0);
+  // Copy the spheres in leaf order.
+  std::vector<double> x(n);
+  std::vector<double> y(n);
+  std::vector<double> z(n);
+  std::vector<double> radius(n);
+  std::vector<int> material_id(n);
+  for (int k = 0; k < n; k++) {
+    int i = items[k].index;
+    Point3 center = spheres.center(i);
+    x[k] = center.x();
+    y[k] = center.y();
+    z[k] = center.z();
+    radius[k] = spheres.radius(i);
+    material_id[k] = spheres.material_id(i);
+  }
+  spheres_.assign(n, x.data(), y.data(), z.data(), radius.data(),
+                  material_id.data());
+}
+
+int BVH::build(std::vector<BuildItem>& items, int begin, int end,
+               int depth) {
+  int node_index = int(nodes_.size());
+  nodes_.emplace_back();
+  AABB bounds;
+  AABB centroid_bounds;
+  for (int i = begin; i < end; i++) {
+    bounds.expand(items[i].bounds);
+    centroid_bounds.expand(items[i].centroid);
+  }
+  nodes_[node_index].bounds = bounds;
+  int count = end - begin;
+  auto make_leaf = [&]() {
+    nodes_[node_index].offset = begin;
+    nodes_[node_index].count = count;
+    return node_index;
+  };
+  if (count == 1) {
+    return make_leaf();
+  }
+
+  // Find the cheapest split over all three axes by sorting the centroids
+  // into bins and sweeping over the boundaries between the bins.
+  int axis = centroid_bounds.longest_axis();
+  double extent = centroid_bounds.max()[axis] - centroid_bounds.min()[axis];
+  int mid = begin + count / 2;
+  if (extent <= 0.0) {
+    // Every centroid is in the same place so there is nothing to split.
+    if (count <= max_leaf_size()) {
+      return make_leaf();
+    }
+  } else if (depth >= MaxSahDepth(items.size())) {
+    std::nth_element(items.begin() + begin, items.begin() + mid,
+                     items.begin() + end,
+                     [axis](const BuildItem& a, const BuildItem& b) {
+                       return a.centroid[axis] < b.centroid[axis];
+                     });
+  } else {
+    double best_cost = std::numeric_limits<double>::infinity();
+    int best_axis = -1;
+    int best_split = 0;
+    for (int a = 0; a < 3; a++) {
+      double low = centroid_bounds.min()[a];
+      double span = centroid_bounds.max()[a] - low;
+      if (span <= 0.0) {
+        continue;
+      }
+      double bin_scale = kNumBins / span;
+      std::array<Bin, kNumBins> bins;
+      for (int i = begin; i < end; i++) {
+        int b = std::min(kNumBins - 1,
+                         int((items[i].centroid[a] - low) * bin_scale));
+        bins[b].count++;
+        bins[b].bounds.expand(items[i].bounds);
+      }
+      // Sweep from the right to record the area and count of every suffix,
+      // then from the left to evaluate each split.
+      std::array<double, kNumBins> right_area{};
+      std::array<int, kNumBins> right_count{};
+      AABB right;
+      int right_total = 0;
+      for (int b = kNumBins - 1; b > 0; b--) {
+        right.expand(bins[b].bounds);
+        right_total += bins[b].count;
+        right_area[b] = right.surface_area();
+        right_count[b] = right_total;
+      }
+      AABB left;
+      int left_total = 0;
+      for (int b = 0; b < kNumBins - 1; b++) {
+        left.expand(bins[b].bounds);
+        left_total += bins[b].count;
+        if (left_total == 0 || right_count[b + 1] == 0) {
+          continue;
+        }
+        double cost = left.surface_area() * intersection_cost(left_total) +
+                      right_area[b + 1] * intersection_cost(right_count[b + 1]);
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = a;
+          best_split = b;
+        }
+      }
+    }
+    double leaf_cost = intersection_cost(count);
+    double split_cost =
+        kTraversalCost + best_cost / std::max(bounds.surface_area(), 1e-300);
+    bool small = count <= max_leaf_size();
+    if (best_axis < 0 || (small && split_cost >= leaf_cost)) {
+      if (count <= max_leaf_size()) {
+        return make_leaf();
+      }
+    } else {
+      axis = best_axis;
+      double low = centroid_bounds.min()[axis];
+      double bin_scale = kNumBins / (centroid_bounds.max()[axis] - low);
+      auto split = std::partition(
+          items.begin() + begin, items.begin() + end,
+          [=](const BuildItem& item) {
+            int b = std::min(kNumBins - 1,
+                             int((item.centroid[axis] - low) * bin_scale));
+            return b <= best_split;
+          });
+      mid = int(split - items.begin());
+    }
+  }
+  if (mid == begin || mid == end) {
+    mid = begin + count / 2;
+  }
+
+  nodes_[node_index].axis = axis;
+  build(items, begin, mid, depth + 1);
+  int second = build(items, mid, end, depth + 1);
+  nodes_[node_index].offset = second;
+  return node_index;
+}
+
+void BVH::build_linear(const SphereSet& spheres, int threads) {
+  int n = spheres.size();
+  // The box around the spheres' centers, put together from the boxes of
+  // blocks of them.
+  int num_blocks = (n + kLinearBlockSize - 1) / kLinearBlockSize;
+  std::vector<AABB> block_bounds(num_blocks);
+  ParallelFor(n, threads, kLinearBlockSize, [&](int begin, int end) {
+    AABB bounds;
+    for (int i = begin; i < end; i++) {
+      bounds.expand(spheres.center(i));
+    }
+    block_bounds[begin / kLinearBlockSize] = bounds;
+  });
+  AABB centroid_bounds;
+  for (const AABB& bounds : block_bounds) {
+    centroid_bounds.expand(bounds);
+  }
+
+  // A key is a sphere's Morton code above its index. The keys start out in
+  // the order of the indices and the sort is stable, so only the codes need
+  // sorting and spheres with the same code stay in the order they came in.
+  // The codes get as many bits as the indices leave, up to 21 per axis.
+  int shift = 1;
+  while (shift < 63 && (std::int64_t(1) << shift) < n) {
+    shift++;
+  }
+  int axis_bits = std::min(21, (64 - shift) / 3);
+  double cells = double((1 << axis_bits) - 1);
+  Point3 low = centroid_bounds.min();
+  Vec3 extent = centroid_bounds.max() - low;
+  std::array<double, 3> scale;
+  for (int axis = 0; axis < 3; axis++) {
+    scale[axis] = extent[axis] > 0 ? cells / extent[axis] : 0;
+  }
+  // While the codes are made the spheres are also copied into one array
+  // of records, so that packing them in sorted order below reads one
+  // record, not five arrays, for each sphere.
+  struct Record {
+    double center[3];
+    double radius;
+    int material_id;
+  };
+  std::vector<Record> records(n);
+  std::vector<std::uint64_t> keys(n);
+  ParallelFor(n, threads, kLinearBlockSize, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      Point3 center = spheres.center(i);
+      std::uint64_t cell[3];
+      for (int axis = 0; axis < 3; axis++) {
+        records[i].center[axis] = center[axis];
+        cell[axis] =
+            std::uint64_t(double(center[axis] - low[axis]) * scale[axis]);
+      }
+      records[i].radius = spheres.radius(i);
+      records[i].material_id = spheres.material_id(i);
+      keys[i] = MortonCode(cell[0], cell[1], cell[2]) << shift |
+                std::uint64_t(i);
+    }
+  });
+  RadixSort(keys, shift, shift + 3 * axis_bits, threads);
+
+  // Pack the spheres in the order of their codes.
+  std::uint64_t index_mask = (std::uint64_t(1) << shift) - 1;
+  std::vector<double> x(n);
+  std::vector<double> y(n);
+  std::vector<double> z(n);
+  std::vector<double> radius(n);
+  std::vector<int> material_id(n);
+  ParallelFor(n, threads, kLinearBlockSize, [&](int begin, int end) {
+    for (int k = begin; k < end; k++) {
+      const Record& record = records[keys[k] & index_mask];
+      x[k] = record.center[0];
+      y[k] = record.center[1];
+      z[k] = record.center[2];
+      radius[k] = record.radius;
+      material_id[k] = record.material_id;
+    }
+  });
+  records = std::vector<Record>();
+  spheres_.assign(n, x.data(), y.data(), z.data(), radius.data(),
+                  material_id.data());
+
+  // The top of the tree is built here, down to subtrees of at most
+  // kLinearBlockSize spheres, each of which is left as a placeholder node
+  // and built on its own on the pool of threads. The subtrees are then put
+  // in place of their placeholders, which keeps the nodes in depth first
+  // order; the tree is the same as if it were built in one piece.
+  struct Subtree {
+    int begin;
+    int end;
+    int depth;
+    std::vector<Node> nodes;
+  };
+  std::vector<Subtree> subtrees;
+  std::vector<Node> top;
+  std::vector<int> top_depth;
+  // Build the top over [begin, end); returns the index of its root in top.
+  auto build_top = [&](int begin, int end, int depth, auto& build_top_ref) {
+    int index = int(top.size());
+    top.emplace_back();
+    if (end - begin <= kLinearBlockSize) {
+      top[index].offset = int(subtrees.size());
+      top[index].count = -1;
+      subtrees.push_back(Subtree{begin, end, depth, {}});
+      return index;
+    }
+    int mid = 0;
+    top[index].axis = LinearSplit(keys, shift, begin, end, depth, mid);
+    build_top_ref(begin, mid, depth + 1, build_top_ref);
+    int second = build_top_ref(mid, end, depth + 1, build_top_ref);
+    top[index].offset = second;
+    return index;
+  };
+  build_top(0, n, 0, build_top);
+  ParallelFor(int(subtrees.size()), threads, 1, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      Subtree& subtree = subtrees[i];
+      subtree.nodes.reserve(std::size_t(2) *
+                            (subtree.end - subtree.begin) /
+                            kMaxLinearLeafSize);
+      emit_linear(keys, shift, subtree.begin, subtree.end, subtree.depth,
+                  subtree.nodes);
+    }
+  });
+
+  // Place the nodes of the top and of the subtrees, and give the top's
+  // nodes their boxes from the bottom up.
+  std::vector<int> position(top.size());
+  int count = 0;
+  for (std::size_t t = 0; t < top.size(); t++) {
+    position[t] = count;
+    count += top[t].count < 0 ? int(subtrees[top[t].offset].nodes.size()) : 1;
+  }
+  nodes_.resize(count);
+  for (std::size_t t = top.size(); t-- > 0;) {
+    Node& node = top[t];
+    if (node.count < 0) {
+      node.bounds = subtrees[node.offset].nodes[0].bounds;
+      continue;
+    }
+    node.bounds = top[t + 1].bounds;
+    node.bounds.expand(top[node.offset].bounds);
+    nodes_[position[t]] = node;
+    nodes_[position[t]].offset = position[node.offset];
+  }
+  ParallelFor(int(top.size()), threads, 1, [&](int begin, int end) {
+    for (int t = begin; t < end; t++) {
+      if (top[t].count >= 0) {
+        continue;
+      }
+      const std::vector<Node>& nodes = subtrees[top[t].offset].nodes;
+      int base = position[t];
+      for (std::size_t k = 0; k < nodes.size(); k++) {
+        Node node = nodes[k];
+        if (node.count == 0) {
+          node.offset += base;
+        }
+        nodes_[base + k] = node;
+      }
+    }
+  });
+}
+
+AABB BVH::emit_linear(const std::vector<std::uint64_t>& keys, int shift,
+                      int begin, int end, int depth,
+                      std::vector<Node>& nodes) const {
+  int index = int(nodes.size());
+  nodes.emplace_back();
+  AABB bounds;
+  if (end - begin <= kMaxLinearLeafSize) {
+    for (int k = begin; k < end; k++) {
+      bounds.expand(spheres_.bounding_box(k));
+    }
+    nodes[index].offset = begin;
+    nodes[index].count = end - begin;
+  } else {
+    int mid = 0;
+    nodes[index].axis = LinearSplit(keys, shift, begin, end, depth, mid);
+    bounds = emit_linear(keys, shift, begin, mid, depth + 1, nodes);
+    nodes[index].offset = int(nodes.size());
+    bounds.expand(emit_linear(keys, shift, mid, end, depth + 1, nodes));
+  }
+  nodes[index].bounds = bounds;
+  return bounds;
+}
+
+bool BVH::hit(const Ray& r, Real t_min, Real t_max,
+              HitRecord& rec) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+  Point3 origin = r.origin();
+  Vec3 direction = r.direction();
+  Vec3 inverse_direction{1.0 / direction.x(), 1.0 / direction.y(),
+                         1.0 / direction.z()};
+  std::array<bool, 3> negative{{direction.x() < 0, direction.y() < 0,
+                                direction.z() < 0}};
+  std::array<int, kStackSize> stack;
+  int top = 0;
+  int current = 0;
+  bool hit_anything = false;
+  Real closest_so_far = t_max;
+  TraversalCounts counts;
+  while (true) {
+    const Node& node = nodes_[current];
+    counts.box_tests++;
+    if (node.bounds.hit(origin, inverse_direction, t_min, closest_so_far)) {
+      counts.object_tests += node.count;
+      if (node.count > 0 && packed_) {
+        if (spheres_.hit(r, node.offset, node.count, t_min, closest_so_far,
+                         rec)) {
+          hit_anything = true;
+          closest_so_far = rec.t;
+        }
+      } else if (node.count > 0) {
+        for (int i = node.offset; i < node.offset + node.count; i++) {
+          if (objects_[i]->hit(r, t_min, closest_so_far, rec)) {
+            hit_anything = true;
+            closest_so_far = rec.t;
+          }
+        }
+      } else {
+        // Visit the child nearest the ray's origin first so that the far
+        // child is more likely to be culled by the closest hit.
+        if (negative[node.axis]) {
+          stack[top++] = current + 1;
+          current = node.offset;
+        } else {
+          stack[top++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+    }
+    if (top == 0) {
+      break;
+    }
+    current = stack[--top];
+  }
+  return hit_anything;
+}
+
+bool BVH::occluded(const Ray& r, Real t_max) const {
+  if (nodes_.empty()) {
+    return false;
+  }
+  Point3 origin = r.origin();
+  Vec3 direction = r.direction();
+  Vec3 inverse_direction{1.0 / direction.x(), 1.0 / direction.y(),
+                         1.0 / direction.z()};
+  std::array<bool, 3> negative{{direction.x() < 0, direction.y() < 0,
+                                direction.z() < 0}};
+  std::array<int, kStackSize> stack;
+  int top = 0;
+  int current = 0;
+  TraversalCounts counts;
+  while (true) {
+    const Node& node = nodes_[current];
+    counts.box_tests++;
+    if (node.bounds.hit(origin, inverse_direction, 0, t_max)) {
+      counts.object_tests += node.count;
+      if (node.count > 0 && packed_) {
+        if (spheres_.occluded(r, node.offset, node.count, t_max)) {
+          return true;
+        }
+      } else if (node.count > 0) {
+        for (int i = node.offset; i < node.offset + node.count; i++) {
+          if (objects_[i]->occluded(r, t_max)) {
+            return true;
+          }
+        }
+      } else {
+        // Any blocker will do, but the near child is the likelier to hold
+        // one when the ray starts on a surface among other objects.
+        if (negative[node.axis]) {
+          stack[top++] = current + 1;
+          current = node.offset;
+        } else {
+          stack[top++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+    }
+    if (top == 0) {
+      break;
+    }
+    current = stack[--top];
+  }
+  return false;
+}
+
+int BVH::hit_packet(RayPacket& packet, Real t_min, HitRecord* recs) const {
+  if (nodes_.empty() || packet.active == 0) {
+    return 0;
+  }
+  // Children are ordered by the direction of the first ray in the packet;
+  // the rays are coherent so the order suits the other rays as well.
+  int lead = 0;
+  while ((packet.active & (1 << lead)) == 0) {
+    lead++;
+  }
+  std::array<int, kStackSize> stack;
+  int top = 0;
+  int current = 0;
+  int hits = 0;
+  std::array<int, kPacketSize> closest;
+  closest.fill(-1);
+  TraversalCounts counts;
+  while (true) {
+    const Node& node = nodes_[current];
+    counts.box_tests++;
+    int mask = node.bounds.hit(packet, t_min);
+    if (mask != 0) {
+      counts.object_tests += node.count;
+      if (node.count > 0 && packed_) {
+        spheres_.hit_packet(packet, node.offset, node.count, t_min,
+                            closest.data());
+      } else if (node.count > 0) {
+        // Objects which are not packed spheres are traced one ray at a time.
+        for (int lane = 0; lane < kPacketSize; lane++) {
+          if ((mask & (1 << lane)) == 0) {
+            continue;
+          }
+          Ray r = packet.ray(lane);
+          for (int i = node.offset; i < node.offset + node.count; i++) {
+            if (objects_[i]->hit(r, t_min, packet.t_max[lane], recs[lane])) {
+              hits |= 1 << lane;
+              packet.t_max[lane] = recs[lane].t;
+            }
+          }
+        }
+      } else {
+        if (packet.direction[node.axis][lead] < 0) {
+          stack[top++] = current + 1;
+          current = node.offset;
+        } else {
+          stack[top++] = node.offset;
+          current = current + 1;
+        }
+        continue;
+      }
+    }
+    if (top == 0) {
+      break;
+    }
+    current = stack[--top];
+  }
+  for (int lane = 0; lane < kPacketSize; lane++) {
+    if (closest[lane] >= 0) {
+      spheres_.record(packet.ray(lane), closest[lane], packet.t_max[lane],
+                      recs[lane]);
+      hits |= 1 << lane;
+    }
+  }
+  return hits;
+}
+
+double BVH::intersection_cost(int count) const {
+  if (packed_) {
+    return double((count + kBatchSize - 1) / kBatchSize);
+  }
+  return double(count);
+}
+
+int BVH::max_leaf_size() const {
+  return packed_ ? kMaxPackedLeafSize : kMaxLeafSize;
+}
+
+AABB BVH::bounding_box() const {
+  return nodes_.empty() ? AABB{} : nodes_[0].bounds;
+}
+
+int BVH::size() const {
+  return packed_ ? spheres_.size() : int(objects_.size());
+}
+
+int BVH::node_count() const { return int(nodes_.size()); }
@@ -0,0 +1,174 @@
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "ray.h"
+#include "sphere_set.h"
+
+/// A bounding volume hierarchy (BVH) is a tree of boxes built over the
+/// objects in a scene. Each node's box encloses everything below it so a
+/// ray which misses a node's box cannot strike anything inside of it and
+/// the whole subtree is skipped. Instead of testing a ray against every
+/// object, only a handful of boxes and objects are visited and the cost of
+/// tracing a ray grows with the logarithm of the number of objects.
+/// See [Bounding volume hierarchy]
+/// (https://en.wikipedia.org/wiki/Bounding_volume_hierarchy).
+///
+/// The tree is built with the surface area heuristic (SAH) which picks the
+/// split that minimizes the expected cost of tracing a random ray. The
+/// nodes are stored flattened in one array in depth first order so the
+/// first child of a node immediately follows it and traversal needs no
+/// pointers. When every object is a Sphere the spheres are also packed in
+/// leaf order into a SphereSet so each leaf is tested with one SIMD batch
+/// instead of one virtual call per sphere.
+///
+/// A tree over spheres can instead be built as a linear BVH (LBVH), as
+/// described by Lauterbach et al. in "Fast BVH Construction on GPUs". Each
+/// sphere's center is given a Morton code, the bits of its cell's x, y and
+/// z interleaved, and the spheres are radix sorted by code, which lays them
+/// out along a [Z-order curve](https://en.wikipedia.org/wiki/Z-order_curve)
+/// that keeps neighbors together. The tree then follows the codes: a
+/// node's spheres are split where their codes first differ. Every step is
+/// a linear pass split over a pool of threads, so the build takes a
+/// fraction of the SAH build's time. The splits take no account of the
+/// spheres' sizes or of the cost of tracing; on spheres spread evenly the
+/// tree traces about as fast as the SAH's, on scenes of very different
+/// sizes or densities it can be much slower.
+/// \code
+/// BVH world{RandomScene(10000)};
+/// HitRecord rec;
+/// if (world.hit(r, 0.0, kInfinity, rec)) { ... }
+/// \endcode
+class BVH : public Hittable {
+ private:
+  /// A node of the flattened tree. Interior nodes have a count of 0 and
+  /// their second child is at offset, the first child is the next node.
+  /// Leaves hold count objects starting at objects_[offset].
+  struct Node {
+    /// The box enclosing everything below this node
+    AABB bounds;
+    /// Leaf: the first object; interior: the index of the second child
+    int offset = 0;
+    /// The number of objects in a leaf, 0 for interior nodes
+    int count = 0;
+    /// The axis the node's children were split along
+    int axis = 0;
+  };
+
+  /// An object's box and the box's center used while building the tree
+  struct BuildItem {
+    AABB bounds;
+    Point3 centroid;
+    int index;
+  };
+
+  /// The objects, reordered so that each leaf's objects are contiguous
+  std::vector<std::shared_ptr<Hittable>> objects_;
+  /// The flattened tree; nodes_[0] is the root
+  std::vector<Node> nodes_;
+  /// The objects packed in leaf order, used when every object is a Sphere
+  SphereSet spheres_;
+  /// True if the leaves are tested with spheres_ instead of objects_
+  bool packed_ = false;
+
+  /// Recursively build the subtree over items[begin, end).
+  /// \returns The index of the subtree's root in nodes_
+  int build(std::vector<BuildItem>& items, int begin, int end, int depth);
+
+  /// Build the tree over \p spheres as a linear BVH and pack the spheres
+  /// into spheres_ in the order of their Morton codes.
+  void build_linear(const SphereSet& spheres, int threads);
+
+  /// Append to \p nodes the subtree of the linear BVH over the packed
+  /// spheres [begin, end), whose keys, sorted, are \p keys; a key holds a
+  /// Morton code above its lowest \p shift bits. Node offsets are given
+  /// relative to the start of \p nodes.
+  /// \returns The box enclosing the subtree
+  AABB emit_linear(const std::vector<std::uint64_t>& keys, int shift,
+                   int begin, int end, int depth,
+                   std::vector<Node>& nodes) const;
+
+  /// The estimated cost of testing a ray against a leaf of \p count objects
+  double intersection_cost(int count) const;
+
+  /// The largest number of objects the builder puts into one leaf
+  int max_leaf_size() const;
+
+ public:
+  /// The largest number of objects the builder puts into one leaf when the
+  /// objects are not packed spheres
+  static const int kMaxLeafSize = 4;
+
+  /// The ways a tree over spheres can be built
+  enum class Builder {
+    /// Top down, choosing each split with the surface area heuristic
+    kSAH,
+    /// As a linear BVH, from the spheres' Morton codes
+    kLinear,
+  };
+
+  /// Build the hierarchy over \p objects.
+  /// \param objects The objects in the scene such as the vector returned
+  /// by RandomScene() or OriginalScene()
+  explicit BVH(std::vector<std::shared_ptr<Hittable>> objects);
+
+  /// Build the hierarchy directly over the spheres of \p spheres, such as
+  /// those of a Scene loaded from a file. No Sphere objects are created.
+  /// \param spheres The spheres in the scene
+  /// \param builder How to build the tree
+  /// \param threads The number of threads building a linear BVH; 0 means
+  /// one per hardware thread. The tree is the same for any number.
+  explicit BVH(const SphereSet& spheres, Builder builder = Builder::kSAH,
+               int threads = 0);
+
+  /// Override the hittable hit() method. The tree is walked front to back
+  /// and the closest hit between \p t_min and \p t_max is stored in \p rec.
+  /// \param r The ray to check for intersection against
+  /// \param t_min The minimum value of the interval to test
+  /// \param t_max The maximum value of the interval to test
+  /// \param rec The HitRecord to store the data needed for shading
+  /// \returns true if the ray struck an object else false
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool hit(const Ray& r, Real t_min, Real t_max,
+           HitRecord& rec) const override;
+
+  /// Override the hittable occluded() method. The tree is walked as in
+  /// hit() but the walk ends at the first leaf with a blocker, and no
+  /// HitRecord is filled in.
+  /// \param r The ray to check for intersection against
+  /// \param t_max The far end of the interval to test, from 0
+  /// \returns true if anything strikes the ray in the interval else false
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool occluded(const Ray& r, Real t_max) const override;
+
+  /// Override the hittable hit_packet() method. The tree is walked once for
+  /// the whole packet: a node is visited if any of the packet's rays
+  /// strikes its box and each leaf is tested against every ray together.
+  /// This pays off for coherent rays such as the camera rays through
+  /// neighboring pixels, which visit nearly the same nodes.
+  /// \param packet The rays to check for intersection against
+  /// \param t_min The minimum value of the interval to test
+  /// \param recs An array of kPacketSize HitRecords, one per lane
+  /// \returns A bit mask with bit i set if the ray in lane i struck an
+  /// object
+  /// \remarks This overrides the method defined in the Hittable class.
+  int hit_packet(RayPacket& packet, Real t_min,
+                 HitRecord* recs) const override;
+
+  /// Override the hittable bounding_box() method.
+  /// \returns The box enclosing every object in the hierarchy
+  AABB bounding_box() const override;
+
+  /// Return the number of objects in the hierarchy
+  int size() const;
+
+  /// Return the number of nodes in the flattened tree
+  int node_count() const;
+};
+
+#endif
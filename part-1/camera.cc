@@ -0,0 +1,49 @@
+#include "camera.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utility.h"
+
+// See the header file for documentation.
+
+bool CheckCameraView(const CameraView& view, std::string& error) {
+  Vec3 forward = view.look_at - view.position;
+  if (!(forward.length_squared() > 0)) {
+    error = "the camera looks at the point it stands on";
+    return false;
+  }
+  if (!(view.up.length_squared() > 0)) {
+    error = "the camera's up direction is zero";
+    return false;
+  }
+  // The sine of the angle between up and the direction the camera looks
+  // in; nearly parallel directions give a right direction made of noise.
+  const double kMinSine = 1e-6;
+  if (!(Cross(UnitVector(view.up), UnitVector(forward)).length() >
+        kMinSine)) {
+    error = "the camera's up direction is along the direction it looks in";
+    return false;
+  }
+  return true;
+}
+
+Camera::Camera(const CameraView& view, int width, int height)
+    : origin_(view.position) {
+  double aspect_ratio = view.aspect_ratio > 0.0
+                            ? view.aspect_ratio
+                            : double(width) / double(height);
+  // The image plane is one unit in front of the camera.
+  double viewport_height =
+      2.0 * std::tan(DegreesToRadians(view.vertical_fov) / 2.0);
+  double viewport_width = aspect_ratio * viewport_height;
+  Vec3 backward = UnitVector(view.position - view.look_at);
+  Vec3 right = UnitVector(Cross(view.up, backward));
+  Vec3 up = Cross(backward, right);
+  Vec3 horizontal = viewport_width * right;
+  Vec3 vertical = viewport_height * up;
+  corner_ = -horizontal / 2 - vertical / 2 - backward;
+  // The last column and row land on the right and top edges.
+  column_step_ = horizontal / double(std::max(1, width - 1));
+  row_step_ = vertical / double(std::max(1, height - 1));
+}
@@ -0,0 +1,72 @@
+#ifndef _CAMERA_H_
+#define _CAMERA_H_
+
+#include <string>
+
+#include "ray.h"
+#include "vec3.h"
+
+/// Where a camera is, where it looks and how much of the scene it sees.
+/// The defaults are those of the fixed camera the renderer has always
+/// used: at the origin, looking down the negative z axis with a 90 degree
+/// vertical field of view.
+struct CameraView {
+  /// The position of the camera
+  Point3 position{0, 0, 0};
+  /// The point the camera looks at
+  Point3 look_at{0, 0, -1};
+  /// The direction which is up in the image
+  Vec3 up{0, 1, 0};
+  /// The vertical field of view in degrees
+  double vertical_fov = 90.0;
+  /// The width of the view divided by its height; 0 means the aspect ratio
+  /// of the image, so that pixels are square
+  double aspect_ratio = 0.0;
+};
+
+/// Check that \p view describes a camera which can be set up: it looks at a
+/// point other than its own position, and its up direction is neither
+/// zero nor along the direction it looks in, either of which would leave
+/// the image's right and up directions undefined.
+/// \param view The camera's position, orientation and field of view
+/// \param error A description of the problem when the view is degenerate
+/// \returns true if a Camera can be made from \p view else false
+bool CheckCameraView(const CameraView& view, std::string& error);
+
+/// A pinhole camera which turns pixel coordinates into camera rays.
+/// Everything that does not depend on the pixel is worked out when the
+/// camera is made: the direction to the lower left pixel and how far the
+/// direction moves from one column, or one row, to the next. Making a ray
+/// through any point of the image is then two multiply-adds per component.
+/// \code
+/// Camera camera{CameraView{}, 1920, 1080};
+/// Ray r = camera.ray(column + RandomDouble01(), row + RandomDouble01());
+/// \endcode
+class Camera {
+ private:
+  /// The position of the camera, where every ray starts
+  Point3 origin_;
+  /// The direction of the ray through the lower left corner of the image
+  Vec3 corner_;
+  /// The change in direction from one column to the next
+  Vec3 column_step_;
+  /// The change in direction from one row to the next, going up
+  Vec3 row_step_;
+
+ public:
+  /// Make the camera described by \p view for an image \p width by
+  /// \p height pixels.
+  /// \param view The camera's position, orientation and field of view
+  /// \param width The width of the image in pixels
+  /// \param height The height of the image in pixels
+  Camera(const CameraView& view, int width, int height);
+
+  /// Return the ray through the point \p column, \p row of the image.
+  /// Columns are counted from the left and rows from the bottom; the
+  /// fractional part gives the position within the pixel.
+  Ray ray(Real column, Real row) const {
+    return Ray{origin_, corner_ + column * column_step_ + row * row_step_};
+  }
+};
+
+#endif
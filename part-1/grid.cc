@@ -0,0 +1,387 @@
+#include "grid.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "parallel.h"
+#include "stats.h"
+
+// See the header file for documentation.
+
+namespace {
+// The most cells along one axis, which bounds the memory a scene of very
+// flat or very many objects takes.
+const int kMaxResolution = 512;
+// The number of objects or cells one thread takes at a time while building.
+const int kBuildBlockSize = 4096;
+
+// Sort the items [0, count) into num_cells cells, where
+// cells_of(i, visit) calls visit(cell) for every cell item i is in. Fills
+// in start, of num_cells + 1 entries, so that cell c's items are
+// [start[c], start[c + 1]) of the list returned.
+template <typename CellsOf>
+std::vector<int> SortIntoCells(int count, int num_cells, int threads,
+                               CellsOf cells_of, std::vector<int>& start) {
+  // Count the items in each cell, add the counts up into the start of each
+  // cell's list, and write each item into the lists of its cells.
+  std::unique_ptr<std::atomic<int>[]> counts(
+      new std::atomic<int>[num_cells]());
+  ParallelFor(count, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      cells_of(i, [&](int cell) {
+        counts[cell].fetch_add(1, std::memory_order_relaxed);
+      });
+    }
+  });
+  start.resize(std::size_t(num_cells) + 1);
+  int total = 0;
+  for (int cell = 0; cell < num_cells; cell++) {
+    start[cell] = total;
+    total += counts[cell].load(std::memory_order_relaxed);
+    counts[cell].store(start[cell], std::memory_order_relaxed);
+  }
+  start[num_cells] = total;
+  std::vector<int> items(total);
+  ParallelFor(count, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      cells_of(i, [&](int cell) {
+        items[counts[cell].fetch_add(1, std::memory_order_relaxed)] = i;
+      });
+    }
+  });
+  // The threads fill a cell's list in no particular order; sorting it makes
+  // the grid, and the object struck when two hits tie, the same every time.
+  ParallelFor(num_cells, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int cell = begin; cell < end; cell++) {
+      std::sort(items.begin() + start[cell], items.begin() + start[cell + 1]);
+    }
+  });
+  return items;
+}
+}  // namespace
+
+Grid::Grid(std::vector<std::shared_ptr<Hittable>> objects, int threads)
+    : num_objects_(int(objects.size())) {
+  if (objects.empty()) {
+    return;
+  }
+  packed_ = std::all_of(objects.begin(), objects.end(),
+                        [](const std::shared_ptr<Hittable>& object) {
+                          return dynamic_cast<Sphere*>(object.get()) !=
+                                 nullptr;
+                        });
+  if (packed_) {
+    SphereSet spheres;
+    for (const auto& object : objects) {
+      spheres.add(*std::static_pointer_cast<Sphere>(object));
+    }
+    *this = Grid{spheres, threads};
+    return;
+  }
+  std::vector<AABB> boxes(objects.size());
+  ParallelFor(num_objects_, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      boxes[i] = objects[i]->bounding_box();
+    }
+  });
+  std::vector<int> order;
+  references_ = build(boxes, threads, order);
+  for (int& reference : references_) {
+    reference = order[reference];
+  }
+  objects_ = std::move(objects);
+}
+
+Grid::Grid(const SphereSet& spheres, int threads)
+    : num_objects_(spheres.size()), packed_(true) {
+  if (num_objects_ == 0) {
+    return;
+  }
+  std::vector<AABB> boxes(num_objects_);
+  ParallelFor(num_objects_, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      boxes[i] = spheres.bounding_box(i);
+    }
+  });
+  std::vector<int> order;
+  std::vector<int> entries = build(boxes, threads, order);
+  pack(spheres, order, entries, threads);
+}
+
+std::vector<int> Grid::build(const std::vector<AABB>& boxes, int threads,
+                             std::vector<int>& order) {
+  int n = int(boxes.size());
+  // Each block of boxes is bounded on its own, and the sizes of its boxes
+  // added up, and the blocks' figures are then put together.
+  int num_blocks = (n + kBuildBlockSize - 1) / kBuildBlockSize;
+  std::vector<AABB> block_bounds(num_blocks);
+  std::vector<double> block_sizes(num_blocks);
+  ParallelFor(n, threads, kBuildBlockSize, [&](int begin, int end) {
+    AABB bounds;
+    double sizes = 0.0;
+    for (int i = begin; i < end; i++) {
+      bounds.expand(boxes[i]);
+      Vec3 size = boxes[i].max() - boxes[i].min();
+      sizes += double(size.x()) + double(size.y()) + double(size.z());
+    }
+    block_bounds[begin / kBuildBlockSize] = bounds;
+    block_sizes[begin / kBuildBlockSize] = sizes;
+  });
+  double mean_size = 0.0;
+  for (int block = 0; block < num_blocks; block++) {
+    bounds_.expand(block_bounds[block]);
+    mean_size += block_sizes[block];
+  }
+  mean_size /= 3.0 * n;
+
+  // Cubic cells, about kCellsPerObject of them per object but no narrower
+  // than the average object: in a crowded scene, narrower cells would list
+  // every object in many cells and cost more memory and time to build than
+  // they save. An axis along which the scene is flat is given a small
+  // length so that the volume, and the number of cells per unit of length,
+  // stays finite.
+  Vec3 extent = bounds_.max() - bounds_.min();
+  double largest = std::max({double(extent.x()), double(extent.y()),
+                             double(extent.z()), 1e-300});
+  double volume = 1.0;
+  for (int axis = 0; axis < 3; axis++) {
+    volume *= std::max(double(extent[axis]), largest * 1e-3);
+  }
+  double cells_per_length = std::cbrt(kCellsPerObject * double(n) / volume);
+  if (mean_size > 0) {
+    cells_per_length = std::min(cells_per_length, 1.0 / mean_size);
+  }
+  std::array<double, 3> cell_size;
+  std::array<double, 3> inverse_cell_size;
+  for (int axis = 0; axis < 3; axis++) {
+    double cells = std::round(double(extent[axis]) * cells_per_length);
+    resolution_[axis] =
+        int(std::max(1.0, std::min(cells, double(kMaxResolution))));
+    // A flat axis has a single cell, which every point maps to.
+    cell_size[axis] = extent[axis] > 0 ? extent[axis] / resolution_[axis] : 1;
+    inverse_cell_size[axis] =
+        extent[axis] > 0 ? resolution_[axis] / extent[axis] : 0;
+  }
+  cell_size_ = Vec3{cell_size[0], cell_size[1], cell_size[2]};
+  inverse_cell_size_ =
+      Vec3{inverse_cell_size[0], inverse_cell_size[1], inverse_cell_size[2]};
+  int num_cells = resolution_[0] * resolution_[1] * resolution_[2];
+
+  // The cell of point p along each axis
+  Point3 origin = bounds_.min();
+  auto cell_of = [&](const Point3& p, int* cell) {
+    for (int axis = 0; axis < 3; axis++) {
+      int c = int((p[axis] - origin[axis]) * inverse_cell_size_[axis]);
+      cell[axis] = std::max(0, std::min(resolution_[axis] - 1, c));
+    }
+  };
+
+  // The objects come in no particular order, and listing them in the cells
+  // as they come writes all over the lists. They are first sorted by the
+  // cell of their centers, one entry each, so that the objects listed one
+  // after the other are neighbors with neighboring lists.
+  auto index = [&](int x, int y, int z) {
+    return (z * resolution_[1] + y) * resolution_[0] + x;
+  };
+  auto center_cell = [&](int i, auto visit) {
+    int cell[3];
+    cell_of(boxes[i].centroid(), cell);
+    visit(index(cell[0], cell[1], cell[2]));
+  };
+  std::vector<int> center_starts;
+  order = SortIntoCells(n, num_cells, threads, center_cell, center_starts);
+  std::vector<AABB> sorted_boxes(n);
+  ParallelFor(n, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int j = begin; j < end; j++) {
+      sorted_boxes[j] = boxes[order[j]];
+    }
+  });
+
+  auto overlapped_cells = [&](int j, auto visit) {
+    int low[3];
+    int high[3];
+    cell_of(sorted_boxes[j].min(), low);
+    cell_of(sorted_boxes[j].max(), high);
+    for (int z = low[2]; z <= high[2]; z++) {
+      for (int y = low[1]; y <= high[1]; y++) {
+        for (int x = low[0]; x <= high[0]; x++) {
+          visit(index(x, y, z));
+        }
+      }
+    }
+  };
+  return SortIntoCells(n, num_cells, threads, overlapped_cells, cell_start_);
+}
+
+void Grid::pack(const SphereSet& spheres, const std::vector<int>& order,
+                const std::vector<int>& entries, int threads) {
+  // The spheres are put in order first; the entries, which list spheres
+  // near each other together, then copy from nearby places.
+  int n = int(order.size());
+  std::vector<Real> sorted(4 * std::size_t(n));
+  std::vector<int> sorted_material_id(n);
+  ParallelFor(n, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int j = begin; j < end; j++) {
+      Point3 center = spheres.center(order[j]);
+      Real* sphere = &sorted[4 * std::size_t(j)];
+      sphere[0] = center.x();
+      sphere[1] = center.y();
+      sphere[2] = center.z();
+      sphere[3] = spheres.radius(order[j]);
+      sorted_material_id[j] = spheres.material_id(order[j]);
+    }
+  });
+  int count = int(entries.size());
+  std::vector<double> x(count);
+  std::vector<double> y(count);
+  std::vector<double> z(count);
+  std::vector<double> radius(count);
+  std::vector<int> material_id(count);
+  ParallelFor(count, threads, kBuildBlockSize, [&](int begin, int end) {
+    for (int k = begin; k < end; k++) {
+      const Real* sphere = &sorted[4 * std::size_t(entries[k])];
+      x[k] = sphere[0];
+      y[k] = sphere[1];
+      z[k] = sphere[2];
+      radius[k] = sphere[3];
+      material_id[k] = sorted_material_id[entries[k]];
+    }
+  });
+  spheres_.assign(count, x.data(), y.data(), z.data(), radius.data(),
+                  material_id.data());
+}
+
+template <typename Visit>
+void Grid::walk(const Ray& r, Real t_min, Real t_max, Visit visit) const {
+  if (cell_start_.empty()) {
+    return;
+  }
+  Point3 origin = r.origin();
+  Vec3 direction = r.direction();
+  Point3 low = bounds_.min();
+  Point3 high = bounds_.max();
+  // Clip the ray to the grid's box. A ray parallel to an axis gives NaN
+  // when it lies in one of the box's faces; std::max() and std::min() then
+  // keep the interval as it was.
+  Real t_enter = t_min;
+  Real t_leave = t_max;
+  for (int axis = 0; axis < 3; axis++) {
+    Real inverse = Real(1) / direction[axis];
+    Real t0 = (low[axis] - origin[axis]) * inverse;
+    Real t1 = (high[axis] - origin[axis]) * inverse;
+    if (inverse < 0) {
+      std::swap(t0, t1);
+    }
+    t_enter = std::max(t_enter, t0);
+    t_leave = std::min(t_leave, t1);
+  }
+  if (!(t_enter <= t_leave)) {
+    return;
+  }
+
+  // Start in the cell where the ray enters and step to whichever of the
+  // next cells along x, y and z the ray reaches first.
+  Point3 start = r.at(t_enter);
+  std::array<int, 3> cell;
+  std::array<int, 3> step;
+  std::array<Real, 3> t_next;
+  std::array<Real, 3> t_delta;
+  for (int axis = 0; axis < 3; axis++) {
+    cell[axis] = std::max(
+        0, std::min(resolution_[axis] - 1,
+                    int((start[axis] - low[axis]) * inverse_cell_size_[axis])));
+    if (direction[axis] > 0) {
+      step[axis] = 1;
+      t_next[axis] = (low[axis] + (cell[axis] + 1) * cell_size_[axis] -
+                      origin[axis]) /
+                     direction[axis];
+      t_delta[axis] = cell_size_[axis] / direction[axis];
+    } else if (direction[axis] < 0) {
+      step[axis] = -1;
+      t_next[axis] =
+          (low[axis] + cell[axis] * cell_size_[axis] - origin[axis]) /
+          direction[axis];
+      t_delta[axis] = -cell_size_[axis] / direction[axis];
+    } else {
+      step[axis] = 0;
+      t_next[axis] = std::numeric_limits<Real>::infinity();
+      t_delta[axis] = 0;
+    }
+  }
+  std::array<int, 3> stride{
+      {1, resolution_[0], resolution_[0] * resolution_[1]}};
+  int index = cell[0] + cell[1] * stride[1] + cell[2] * stride[2];
+  TraversalCounts counts;
+  while (true) {
+    int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2)
+                                     : (t_next[1] < t_next[2] ? 1 : 2);
+    Real t_exit = t_next[axis];
+    int first = cell_start_[index];
+    int count = cell_start_[index + 1] - first;
+    counts.box_tests++;
+    counts.object_tests += count;
+    if (count > 0 && visit(first, count, t_exit)) {
+      return;
+    }
+    if (t_exit >= t_leave) {
+      return;
+    }
+    cell[axis] += step[axis];
+    if (cell[axis] < 0 || cell[axis] >= resolution_[axis]) {
+      return;
+    }
+    index += step[axis] * stride[axis];
+    t_next[axis] += t_delta[axis];
+  }
+}
+
+bool Grid::hit(const Ray& r, Real t_min, Real t_max, HitRecord& rec) const {
+  bool hit_anything = false;
+  Real closest_so_far = t_max;
+  walk(r, t_min, t_max, [&](int first, int count, Real t_exit) {
+    if (packed_) {
+      if (spheres_.hit(r, first, count, t_min, closest_so_far, rec)) {
+        hit_anything = true;
+        closest_so_far = rec.t;
+      }
+    } else {
+      for (int k = first; k < first + count; k++) {
+        if (objects_[references_[k]]->hit(r, t_min, closest_so_far, rec)) {
+          hit_anything = true;
+          closest_so_far = rec.t;
+        }
+      }
+    }
+    // An object listed in this cell may be struck in a later cell, so a
+    // hit only ends the walk once it is inside the cell.
+    return hit_anything && closest_so_far <= t_exit;
+  });
+  return hit_anything;
+}
+
+bool Grid::occluded(const Ray& r, Real t_max) const {
+  bool blocked = false;
+  walk(r, 0, t_max, [&](int first, int count, Real /*t_exit*/) {
+    if (packed_) {
+      blocked = spheres_.occluded(r, first, count, t_max);
+    } else {
+      for (int k = first; k < first + count && !blocked; k++) {
+        blocked = objects_[references_[k]]->occluded(r, t_max);
+      }
+    }
+    return blocked;
+  });
+  return blocked;
+}
+
+AABB Grid::bounding_box() const { return bounds_; }
+
+int Grid::size() const { return num_objects_; }
+
+std::array<int, 3> Grid::resolution() const { return resolution_; }
+
+int Grid::reference_count() const {
+  return cell_start_.empty() ? 0 : cell_start_.back();
+}
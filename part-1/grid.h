@@ -0,0 +1,142 @@
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#include <array>
+#include <memory>
+#include <vector>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "ray.h"
+#include "sphere_set.h"
+
+/// A uniform grid divides the box around the scene into equal cells and
+/// lists in each cell the objects whose boxes overlap it. A ray walks the
+/// cells it passes through in order, from the nearest to the farthest, with
+/// the 3D digital differential analyzer (3D-DDA) of [Amanatides and Woo]
+/// (http://www.cse.yorku.ca/~amana/research/grid.pdf), and only tests the
+/// objects listed in those cells. A hit inside the cell being visited is
+/// closer than anything in the cells after it, so the walk ends at the
+/// first cell holding a hit.
+///
+/// A grid suits scenes of many objects of about the same size spread
+/// evenly through a box, such as RandomScene()'s, where it is cheaper to
+/// build than a BVH and a ray visits few empty cells. Objects of very
+/// different sizes, or clustered in a corner of the scene, favor the BVH.
+///
+/// The resolution is chosen from the number of objects and the shape of
+/// the scene's box so that the cells are close to cubes and there are
+/// about kCellsPerObject cells per object. Building is linear in the
+/// number of objects and runs on a pool of threads: the objects are
+/// counted into their cells, the counts are added up into the start of
+/// each cell's list, and the objects are written into the lists. As in the
+/// BVH, spheres are copied in cell order into a SphereSet so each cell is
+/// tested with one SIMD batch; a sphere which overlaps several cells is
+/// copied into each of them.
+/// \code
+/// Grid world{scene.spheres};
+/// HitRecord rec;
+/// if (world.hit(r, 0.0, kInfinity, rec)) { ... }
+/// \endcode
+class Grid : public Hittable {
+ private:
+  /// The number of objects
+  int num_objects_ = 0;
+  /// The box around every object, divided into the cells
+  AABB bounds_;
+  /// The number of cells along x, y and z
+  std::array<int, 3> resolution_{{0, 0, 0}};
+  /// The size of a cell along x, y and z, and its reciprocal
+  Vec3 cell_size_;
+  Vec3 inverse_cell_size_;
+  /// The lists of the cells, one after the other; cell c's list is
+  /// [cell_start_[c], cell_start_[c + 1]). Cells are numbered with x
+  /// changing fastest.
+  std::vector<int> cell_start_;
+  /// The index in objects_ of each entry of the lists, when the objects are
+  /// not packed spheres
+  std::vector<int> references_;
+  /// The objects
+  std::vector<std::shared_ptr<Hittable>> objects_;
+  /// A copy of the spheres for each entry of the lists, used when every
+  /// object is a Sphere
+  SphereSet spheres_;
+  /// True if the cells are tested with spheres_ instead of objects_
+  bool packed_ = false;
+
+  /// Choose the resolution and list the objects, whose boxes are
+  /// \p boxes, in the cells they overlap. The objects are put in an order
+  /// in which neighbors are near each other, \p order, where order[j] is
+  /// the index of the j-th object.
+  /// \returns For each entry of the lists, the position in \p order of its
+  /// object
+  std::vector<int> build(const std::vector<AABB>& boxes, int threads,
+                         std::vector<int>& order);
+
+  /// Fill spheres_ with a copy of sphere order[entries[k]] of \p spheres
+  /// for each entry k of the lists.
+  void pack(const SphereSet& spheres, const std::vector<int>& order,
+            const std::vector<int>& entries, int threads);
+
+  /// Walk the cells \p r passes through between \p t_min and \p t_max,
+  /// calling visit(first, count, t_exit) with each cell's list and the
+  /// distance at which the ray leaves the cell until visit returns true.
+  template <typename Visit>
+  void walk(const Ray& r, Real t_min, Real t_max, Visit visit) const;
+
+ public:
+  /// The number of cells per object the resolution aims for
+  static const int kCellsPerObject = 2;
+
+  /// Build the grid over \p objects.
+  /// \param objects The objects in the scene such as the vector returned
+  /// by RandomScene() or OriginalScene()
+  /// \param threads The number of threads building the grid; 0 means one
+  /// per hardware thread
+  explicit Grid(std::vector<std::shared_ptr<Hittable>> objects,
+                int threads = 0);
+
+  /// Build the grid directly over the spheres of \p spheres, such as those
+  /// of a Scene loaded from a file. No Sphere objects are created.
+  /// \param spheres The spheres in the scene
+  /// \param threads The number of threads building the grid; 0 means one
+  /// per hardware thread
+  explicit Grid(const SphereSet& spheres, int threads = 0);
+
+  /// Override the hittable hit() method. The cells are visited front to
+  /// back and the closest hit between \p t_min and \p t_max is stored in
+  /// \p rec.
+  /// \param r The ray to check for intersection against
+  /// \param t_min The minimum value of the interval to test
+  /// \param t_max The maximum value of the interval to test
+  /// \param rec The HitRecord to store the data needed for shading
+  /// \returns true if the ray struck an object else false
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool hit(const Ray& r, Real t_min, Real t_max,
+           HitRecord& rec) const override;
+
+  /// Override the hittable occluded() method. The cells are visited as in
+  /// hit() but the walk ends at the first blocker, and no HitRecord is
+  /// filled in.
+  /// \param r The ray to check for intersection against
+  /// \param t_max The far end of the interval to test, from 0
+  /// \returns true if anything strikes the ray in the interval else false
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool occluded(const Ray& r, Real t_max) const override;
+
+  /// Override the hittable bounding_box() method.
+  /// \returns The box enclosing every object in the grid
+  AABB bounding_box() const override;
+
+  /// Return the number of objects in the grid
+  int size() const;
+
+  /// Return the number of cells along x, y and z
+  std::array<int, 3> resolution() const;
+
+  /// Return the number of entries in the cells' lists; an object is listed
+  /// once for every cell it overlaps
+  int reference_count() const;
+};
+
+#endif
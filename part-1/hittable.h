@@ -2,12 +2,9 @@
 #ifndef _HITTABLE_H_
 #define _HITTABLE_H_
 
-#include <memory>
-
+#include "aabb.h"
 #include "ray.h"
-
-// Forward declaration of the Material class needed for the HitRecord
-class Material;
+#include "ray_packet.h"
 
 /// HitRecord for data assciated with ray-object intersection
 /// A struct is like a class yet it is typically used to store
@@ -21,12 +18,13 @@ struct HitRecord {
   /// The [normal](https://en.wikipedia.org/wiki/Normal_(geometry)) to the
   /// point where the ray struck the object
   Vec3 normal;
-  /// A pointer to the hit's material property; given by the object struck
-  std::shared_ptr<Material> material;
+  /// The ID of the hit's material in the MaterialTable; given by the object
+  /// struck. Recording and copying hits only copies this small number.
+  int material_id = -1;
   /// If the ray is evaluated at t, the point p is yieled. Recall that
   /// a point P(t) can be found on a ray by evaluating the ray at t
   /// O + td, where O is the ray origin and d is the vector direction.
-  double t = NAN;
+  Real t = NAN;
 };
 
 /// An abstract class defining what it means to be hittable by a ray.
@@ -59,8 +57,49 @@ class Hittable {
   /// this class. In essence, if a class inherits from hittable, then
   /// this method means that you can check to see if a ray intersects
   /// with the object.
-  virtual bool hit(const Ray& r, double t_min, double t_max,
+  virtual bool hit(const Ray& r, Real t_min, Real t_max,
                    HitRecord& rec) const = 0;
+
+  /// Check if anything blocks the ray \p r between its origin and
+  /// \p t_max. This is the query a shadow ray makes: it only asks whether
+  /// there is a hit, not which one is closest, so it returns at the first
+  /// blocker found and fills in no HitRecord. This version falls back on
+  /// hit(); classes that can stop sooner, such as the BVH, override it.
+  /// \param r The ray to check for intersection against
+  /// \param t_max The far end of the interval to test, from 0
+  /// \returns true if anything strikes the ray in the interval else false
+  virtual bool occluded(const Ray& r, Real t_max) const {
+    HitRecord rec;
+    return hit(r, 0, t_max, rec);
+  }
+
+  /// Virtual method bounding_box must be defined by any class that inherits
+  /// from this class. It returns the box which encloses the object so that
+  /// acceleration structures such as the BVH can skip over the object when
+  /// a ray does not pass near it.
+  virtual AABB bounding_box() const = 0;
+
+  /// Find the closest hit of every ray in \p packet between \p t_min and
+  /// the ray's t_max. Each hit lowers its lane's t_max and is stored in
+  /// recs[lane]. This version traces the rays one at a time; classes that
+  /// can trace the lanes together, such as the BVH, override it.
+  /// \param packet The rays to check for intersection against
+  /// \param t_min The minimum value of the interval to test
+  /// \param recs An array of kPacketSize HitRecords, one per lane
+  /// \returns A bit mask with bit i set if the ray in lane i struck an
+  /// object
+  virtual int hit_packet(RayPacket& packet, Real t_min,
+                         HitRecord* recs) const {
+    int hits = 0;
+    for (int lane = 0; lane < kPacketSize; lane++) {
+      if ((packet.active & (1 << lane)) != 0 &&
+          hit(packet.ray(lane), t_min, packet.t_max[lane], recs[lane])) {
+        packet.t_max[lane] = recs[lane].t;
+        hits |= 1 << lane;
+      }
+    }
+    return hits;
+  }
 };
 
 #endif
\ No newline at end of file
@@ -1,47 +1,199 @@
-
 #include "image.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
 // See the header file for documentation.
 
-void Image::header() {
-  if (is_open()) {
-    output_stream_ << "P3\n";
-    output_stream_ << "# The P3 means colors are in ACII, then the number\n";
-    output_stream_ << "# of columns (" << width_ << ") and the number of\n";
-    output_stream_ << "# rows (" << height_ << "), then 255 for the max\n";
-    output_stream_ << "# color, then RGB triples.\n";
-    output_stream_ << width_ << " " << height_ << "\n255\n";
+namespace {
+// Gamma correct (gamma 2) and clamp a linear channel value to [0, 1].
+double Encode(double linear) {
+  return std::sqrt(std::min(std::max(linear, 0.0), 1.0));
+}
+
+// Append the decimal digits of value to buffer; much faster than an ostream.
+void AppendInt(std::string& buffer, long value) {
+  char digits[24];
+  int n = 0;
+  do {
+    digits[n++] = char('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (n > 0) {
+    buffer.push_back(digits[--n]);
+  }
+}
+
+bool IsLittleEndian() {
+  const std::uint16_t kOne = 1;
+  unsigned char first_byte = 0;
+  std::memcpy(&first_byte, &kOne, 1);
+  return first_byte == 1;
+}
+}  // namespace
+
+bool ImageFormatFromName(const std::string& name, ImageFormat& format) {
+  if (name == "p3") {
+    format = ImageFormat::kP3;
+  } else if (name == "p6") {
+    format = ImageFormat::kP6;
+  } else if (name == "p6-16") {
+    format = ImageFormat::kP6Deep;
+  } else if (name == "pfm") {
+    format = ImageFormat::kPFM;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void Image::header(std::string& buffer) const {
+  std::string size = std::to_string(width_) + " " + std::to_string(height_);
+  switch (format_) {
+    case ImageFormat::kP3:
+      buffer += "P3\n";
+      buffer += "# The P3 means colors are in ACII, then the number\n";
+      buffer += "# of columns (" + std::to_string(width_);
+      buffer += ") and the number of\n";
+      buffer += "# rows (" + std::to_string(height_);
+      buffer += "), then 255 for the max\n";
+      buffer += "# color, then RGB triples.\n";
+      buffer += size + "\n255\n";
+      break;
+    case ImageFormat::kP6:
+      buffer += "P6\n" + size + "\n255\n";
+      break;
+    case ImageFormat::kP6Deep:
+      buffer += "P6\n" + size + "\n65535\n";
+      break;
+    case ImageFormat::kPFM:
+      // A negative scale means the floats are little endian.
+      buffer += "PF\n" + size + (IsLittleEndian() ? "\n-1.0\n" : "\n1.0\n");
+      break;
+  }
+}
+
+void Image::encode(std::string& buffer) const {
+  std::size_t num_pixels = framebuffer_.size();
+  switch (format_) {
+    case ImageFormat::kP3:
+      buffer.reserve(buffer.size() + num_pixels * 12);
+      for (const Color& c : framebuffer_) {
+        AppendInt(buffer, lround(255.0 * Encode(c.r())));
+        buffer.push_back(' ');
+        AppendInt(buffer, lround(255.0 * Encode(c.g())));
+        buffer.push_back(' ');
+        AppendInt(buffer, lround(255.0 * Encode(c.b())));
+        buffer.push_back('\n');
+      }
+      break;
+    case ImageFormat::kP6:
+      buffer.reserve(buffer.size() + num_pixels * 3);
+      for (const Color& c : framebuffer_) {
+        for (int channel = 0; channel < 3; channel++) {
+          buffer.push_back(char(lround(255.0 * Encode(c[channel]))));
+        }
+      }
+      break;
+    case ImageFormat::kP6Deep:
+      // 16 bit samples are stored most significant byte first.
+      buffer.reserve(buffer.size() + num_pixels * 6);
+      for (const Color& c : framebuffer_) {
+        for (int channel = 0; channel < 3; channel++) {
+          auto sample = std::uint16_t(lround(65535.0 * Encode(c[channel])));
+          buffer.push_back(char(sample >> 8U));
+          buffer.push_back(char(sample & 0xFFU));
+        }
+      }
+      break;
+    case ImageFormat::kPFM: {
+      // PFM stores the rows from the bottom of the image to the top.
+      std::size_t row_bytes = std::size_t(width_) * 3 * sizeof(float);
+      std::size_t start = buffer.size();
+      buffer.resize(start + row_bytes * std::size_t(height_));
+      char* out = &buffer[start];
+      for (int row = height_ - 1; row >= 0; row--) {
+        for (int column = 0; column < width_; column++) {
+          const Color& c =
+              framebuffer_[std::size_t(row) * std::size_t(width_) + column];
+          float rgb[3] = {float(c.r()), float(c.g()), float(c.b())};
+          std::memcpy(out, rgb, sizeof(rgb));
+          out += sizeof(rgb);
+        }
+      }
+      break;
+    }
   }
 }
 
-Image::Image(const std::string& file_name, int width, int height) {
+Image::Image(const std::string& file_name, int width, int height,
+             ImageFormat format) {
   file_name_ = file_name;
   width_ = width;
   height_ = height;
   aspect_ratio_ = double(width_) / double(height_);
-  output_stream_ = std::ofstream(file_name_);
-  header();
+  format_ = format;
+  framebuffer_.resize(std::size_t(width_) * std::size_t(height_));
+  next_pixel_ = 0;
+  output_stream_ = std::ofstream(file_name_, std::ios::binary);
 }
 
 bool Image::is_open() { return output_stream_.is_open(); }
 
 void Image::write(int red, int green, int blue) {
-  output_stream_ << red << " " << green << " "
-                 << " " << blue << "\n";
+  // The values are already gamma corrected; undo it to store linear color.
+  double r = red / 255.0;
+  double g = green / 255.0;
+  double b = blue / 255.0;
+  write(Color{r * r, g * g, b * b});
 }
 
 void Image::write(const Color& c) {
-  // Get the color value, multiple by 255.0 and use lround() to round
-  // to the nearest integer.
-  // Write the values out to the output_stream.
-  auto r = lround(255.0 * c.r());
-  auto g = lround(255.0 * c.g());
-  auto b = lround(255.0 * c.b());
-  output_stream_ << r << " " << g << " " << b << "\n";
+  if (next_pixel_ < framebuffer_.size()) {
+    framebuffer_[next_pixel_++] = c;
+  }
+}
+
+void Image::write_framebuffer(const std::vector<Color>& framebuffer) {
+  std::size_t n = std::min(framebuffer.size(), framebuffer_.size());
+  std::copy_n(framebuffer.begin(), n, framebuffer_.begin());
+  std::fill(framebuffer_.begin() + std::ptrdiff_t(n), framebuffer_.end(),
+            Color{});
+  next_pixel_ = framebuffer_.size();
 }
 
-void Image::close() { output_stream_.close(); }
+void Image::write_file() {
+  if (written_) {
+    // Reopening the file empties it; an image in the P3 format can encode
+    // to fewer bytes than the one it replaces.
+    output_stream_.close();
+    output_stream_.open(file_name_, std::ios::binary | std::ios::trunc);
+  }
+  std::string buffer;
+  header(buffer);
+  encode(buffer);
+  output_stream_.write(buffer.data(), std::streamsize(buffer.size()));
+  output_stream_.flush();
+  written_ = true;
+}
+
+void Image::write_preview() {
+  if (is_open()) {
+    write_file();
+  }
+}
+
+void Image::close() {
+  if (is_open()) {
+    write_file();
+  }
+  output_stream_.close();
+}
 
 int Image::width() const { return width_; }
 
 int Image::height() const { return height_; }
+
+ImageFormat Image::format() const { return format_; }
@@ -4,16 +4,43 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
 
 #include "vec3.h"
 
-/// Image class to help create image files in the PPM format.
+/// The file formats an Image can be saved in. All of them are members of the
+/// [Netpbm](https://en.wikipedia.org/wiki/Netpbm) family.
+enum class ImageFormat {
+  /// ASCII PPM; every channel is written as text. Easy to read, slow to
+  /// write and several times larger than the binary formats.
+  kP3,
+  /// Binary PPM with 8 bits per channel
+  kP6,
+  /// Binary PPM with 16 bits per channel
+  kP6Deep,
+  /// Portable Float Map; linear 32 bit floating point channels for HDR
+  kPFM,
+};
+
+/// Look up an image format by its name: "p3", "p6", "p6-16", or "pfm".
+/// \param name The name of the format
+/// \param format The format with that name
+/// \returns true if the name is a known format else false
+bool ImageFormatFromName(const std::string& name, ImageFormat& format);
+
+/// Image class to help create image files in the PPM family of formats.
 /// The image is created by specifying a path to a file to create along
 /// with the dimensions of the image expressed as the width and height
-/// of the image in pixels. The image is constructed one pixel at a time.
-/// It is up to the application program to manage the image's scanlines.
-// Each pixel is written to the image starting at it's upper left corner
+/// of the image in pixels. The pixels are collected in an in-memory
+/// framebuffer, either one pixel at a time with write() or all at once
+/// with write_framebuffer(). When the image is closed the framebuffer is
+/// encoded and written to the file in a single bulk write.
+/// Each pixel is written to the image starting at it's upper left corner
 /// and ending at the image's lower right corner.
+///
+/// Colors are given in linear space. The 8 and 16 bit formats gamma correct
+/// (gamma 2) and clamp the colors when the file is written while PFM keeps
+/// the linear values as they are.
 class Image {
  private:
   /// The output file name
@@ -24,17 +51,32 @@ class Image {
   int height_;
   /// The image's aspect ratio expressed as width : height.
   double aspect_ratio_;
+  /// The format the file is written in
+  ImageFormat format_;
+  /// The pixels, row by row from the upper left corner
+  std::vector<Color> framebuffer_;
+  /// The index of the pixel the next call to write() sets
+  std::size_t next_pixel_;
   /// The output file stream where the data gets written
   std::ofstream output_stream_;
-  /// Utility method to print the header to the output file.
-  void header();
+  /// True once the framebuffer has been written to the file
+  bool written_ = false;
+  /// Utility method to print the header to the output buffer.
+  void header(std::string& buffer) const;
+  /// Utility method to encode the framebuffer into the output buffer.
+  void encode(std::string& buffer) const;
+  /// Encode the framebuffer and write it to the file, replacing anything
+  /// written to it before.
+  void write_file();
 
  public:
   /// Initialize a new image file with the given path and dimensions.
   /// \param file_name The path to the file to create
   /// \param width The width of the image in pixels
   /// \param height The height of the image in pixels
-  Image(const std::string& file_name, int width, int height);
+  /// \param format The format to write the file in
+  Image(const std::string& file_name, int width, int height,
+        ImageFormat format = ImageFormat::kP6);
 
   // Remove unwanted constructors, copy, and move operations.
   Image() = delete;
@@ -44,7 +86,7 @@ class Image {
   Image& operator=(Image&& i) = delete;
 
   /// Image destructor.
-  /// If the output file is open, close it.
+  /// If the output file is open, write the framebuffer and close it.
   ~Image() {
     if (is_open()) {
       close();
@@ -57,23 +99,36 @@ class Image {
   /// recreted. Be careful!
   bool is_open();
 
-  /// Write the pixel values red, green, and blue to the next scanline.
-  /// The values of \p red, \p green, and \p blue must be between 0 and 255.
+  /// Write the pixel values red, green, and blue to the next pixel.
+  /// The values of \p red, \p green, and \p blue must be between 0 and 255
+  /// and are already gamma corrected, just as they appear in the file.
   /// \param red The red channel's value as an int. [0, 255]
   /// \param green The green channel's value as an int. [0, 255]
   /// \param blue The blue channel's value as an int. [0, 255]
   void write(int red, int green, int blue);
 
-  /// Write the pixel value \p c to the next scanline, \p c represents a
+  /// Write the pixel value \p c to the next pixel, \p c represents a
   /// three channel (red, green, blue) color pixel.
   /// The type Color is really a Vec3. We can access the red, green, and blue
   /// color channels with the methods r(), g(), b() respectively.
-  /// Remember that these values are doubles (between 0 and 1) and need to
-  /// be converted to integer values between 0 and 255.
-  /// \param c A color pixel with 3 channels: red, green and blue.
+  /// \param c A linear color pixel with 3 channels: red, green and blue.
   void write(const Color& c);
 
-  /// Close the output file stream associated with the Image object
+  /// Replace every pixel of the image with \p framebuffer. The pixels are
+  /// copied into the image's own buffer, which is allocated when the image
+  /// is opened, so no memory is allocated here.
+  /// \param framebuffer width() * height() linear colors, row by row from
+  /// the upper left corner, such as the framebuffer returned by Render();
+  /// pixels it is short of are black
+  void write_framebuffer(const std::vector<Color>& framebuffer);
+
+  /// Encode the framebuffer and write it to the file now, leaving the file
+  /// open. A later write_preview() or close() replaces what this wrote, so
+  /// the file can show an image which is still being rendered.
+  void write_preview();
+
+  /// Encode the framebuffer, write it to the file and close the output file
+  /// stream associated with the Image object
   void close();
 
   /// The width of the image in pixels
@@ -83,7 +138,10 @@ class Image {
   /// The height of the image in pixels
   /// \returns the height of the image in pixels
   int height() const;
+
+  /// The format the image is written in
+  ImageFormat format() const;
 };
 
 // End header guard
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,197 @@
+#include "light.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "aabb.h"
+#include "rng.h"
+
+// See the header file for documentation.
+
+namespace {
+// The grid has about this many cells per point light, and no more than
+// kMaxCells cells in all.
+const int kCellsPerLight = 8;
+const int kMaxCells = 1 << 18;
+
+// The brightest channel of c
+Real Power(const Color& c) { return std::max({c.r(), c.g(), c.b()}); }
+}  // namespace
+
+std::vector<Light> DefaultLights() {
+  Point3 position{20, 20, -1};
+  return {Light{Light::Type::kPoint, position,
+                position.length_squared() * Color{1, 1, 1}}};
+}
+
+LightList::LightList(const std::vector<Light>& lights, double cutoff,
+                     int max_samples)
+    : max_samples_{std::max(0, max_samples)} {
+  const Real kInf = std::numeric_limits<Real>::infinity();
+  AABB bounds;
+  for (const Light& light : lights) {
+    Real power = Power(light.color);
+    if (!(power > 0)) {
+      continue;
+    }
+    if (light.type == Light::Type::kDirectional) {
+      if (power < cutoff) {
+        // Too dim to light anything.
+        continue;
+      }
+      directionals_.push_back(
+          Light{light.type, UnitVector(light.vector), light.color});
+      continue;
+    }
+    Real radius_squared = cutoff > 0 ? Real(power / cutoff) : kInf;
+    points_.push_back(
+        PointLight{light.vector, light.color, radius_squared});
+    if (cutoff > 0) {
+      Real radius = std::sqrt(radius_squared);
+      Vec3 extent{radius, radius, radius};
+      bounds.expand(AABB{light.vector - extent, light.vector + extent});
+    }
+  }
+  cell_start_.assign(1, 0);
+  if (points_.empty()) {
+    return;
+  }
+  if (!(cutoff > 0)) {
+    // Nothing is culled so every light goes into a single cell which
+    // covers all of space.
+    cull_ = false;
+    cells_[0] = cells_[1] = cells_[2] = 1;
+    cell_start_.push_back(int(points_.size()));
+    for (int i = 0; i < int(points_.size()); i++) {
+      cell_lights_.push_back(i);
+    }
+    return;
+  }
+
+  // Pick roughly cubic cells, about kCellsPerLight of them per light.
+  Vec3 extent = bounds.max() - bounds.min();
+  double volume = double(extent.x()) * extent.y() * extent.z();
+  int target = std::min(kCellsPerLight * int(points_.size()), kMaxCells);
+  double cell_size = std::cbrt(volume / target);
+  for (int axis = 0; axis < 3; axis++) {
+    cells_[axis] = int(std::ceil(extent[axis] / cell_size));
+    cells_[axis] = std::max(1, std::min(cells_[axis], kMaxCells));
+    inverse_cell_size_[axis] = Real(cells_[axis]) / extent[axis];
+  }
+  grid_min_ = bounds.min();
+  long long num_cells = (long long)cells_[0] * cells_[1] * cells_[2];
+  if (num_cells > kMaxCells) {
+    // Very flat bounds round up to many cells; fall back to a coarse grid.
+    cells_[0] = cells_[1] = cells_[2] = 16;
+    num_cells = 16 * 16 * 16;
+    for (int axis = 0; axis < 3; axis++) {
+      inverse_cell_size_[axis] = Real(16) / extent[axis];
+    }
+  }
+
+  // Count the lights overlapping each cell, then fill in the lists.
+  auto cell_range = [this](const PointLight& light, int* low, int* high) {
+    Real radius = std::sqrt(light.radius_squared);
+    for (int axis = 0; axis < 3; axis++) {
+      Real start = light.position[axis] - radius - grid_min_[axis];
+      Real end = light.position[axis] + radius - grid_min_[axis];
+      low[axis] = std::max(0, int(start * inverse_cell_size_[axis]));
+      high[axis] = std::min(cells_[axis] - 1,
+                            int(end * inverse_cell_size_[axis]));
+    }
+  };
+  std::vector<int> counts(num_cells + 1, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < int(points_.size()); i++) {
+      int low[3];
+      int high[3];
+      cell_range(points_[i], low, high);
+      for (int z = low[2]; z <= high[2]; z++) {
+        for (int y = low[1]; y <= high[1]; y++) {
+          for (int x = low[0]; x <= high[0]; x++) {
+            int c = (z * cells_[1] + y) * cells_[0] + x;
+            if (pass == 0) {
+              counts[c + 1]++;
+            } else {
+              cell_lights_[counts[c]++] = i;
+            }
+          }
+        }
+      }
+    }
+    if (pass == 0) {
+      for (int c = 0; c < num_cells; c++) {
+        counts[c + 1] += counts[c];
+      }
+      cell_start_ = counts;
+      cell_lights_.resize(counts[num_cells]);
+    }
+  }
+}
+
+int LightList::cell(const Point3& p) const {
+  if (!cull_) {
+    return 0;
+  }
+  int index[3];
+  for (int axis = 0; axis < 3; axis++) {
+    Real offset = (p[axis] - grid_min_[axis]) * inverse_cell_size_[axis];
+    if (!(offset >= 0 && offset < cells_[axis])) {
+      return -1;
+    }
+    index[axis] = int(offset);
+  }
+  return (index[2] * cells_[1] + index[1]) * cells_[0] + index[0];
+}
+
+void LightList::sample(const Point3& p,
+                       std::vector<LightSample>& samples) const {
+  const Real kInf = std::numeric_limits<Real>::infinity();
+  samples.clear();
+  for (const Light& light : directionals_) {
+    samples.push_back(LightSample{-light.vector, kInf, light.color});
+  }
+  int c = points_.empty() ? -1 : cell(p);
+  if (c >= 0) {
+    for (int i = cell_start_[c]; i < cell_start_[c + 1]; i++) {
+      const PointLight& light = points_[cell_lights_[i]];
+      Vec3 to_light = light.position - p;
+      Real distance_squared = to_light.length_squared();
+      if (distance_squared < light.radius_squared && distance_squared > 0) {
+        samples.push_back(
+            LightSample{to_light, 1, light.color / distance_squared});
+      }
+    }
+  }
+  int count = int(samples.size());
+  if (max_samples_ == 0 || count <= max_samples_) {
+    return;
+  }
+
+  // Choose max_samples_ of the lights, each with a chance proportional to
+  // its brightness at p, and weight each choice by the inverse of that
+  // chance over the number of choices.
+  thread_local std::vector<double> cumulative;
+  cumulative.resize(count);
+  double total = 0.0;
+  for (int i = 0; i < count; i++) {
+    total += Power(samples[i].color);
+    cumulative[i] = total;
+  }
+  for (int k = 0; k < max_samples_; k++) {
+    double u = RandomDouble01() * total;
+    int i = int(std::upper_bound(cumulative.begin(), cumulative.end(), u) -
+                cumulative.begin());
+    i = std::min(i, count - 1);
+    LightSample chosen = samples[i];
+    double chance = Power(chosen.color) / total;
+    chosen.color = Real(1.0 / (chance * max_samples_)) * chosen.color;
+    samples.push_back(chosen);
+  }
+  samples.erase(samples.begin(), samples.begin() + count);
+}
+
+int LightList::size() const {
+  return int(points_.size() + directionals_.size());
+}
@@ -0,0 +1,114 @@
+#ifndef _LIGHT_H_
+#define _LIGHT_H_
+
+#include <vector>
+
+#include "vec3.h"
+
+/// A light which shines on the scene.
+struct Light {
+  /// A point light shines from a position in every direction; a
+  /// directional light is infinitely far away and shines along a direction.
+  enum class Type { kPoint, kDirectional };
+  /// The kind of light
+  Type type = Type::kPoint;
+  /// The position of a point light or the direction of a directional light
+  Vec3 vector;
+  /// The color and intensity of the light. A point light's light falls off
+  /// with the square of the distance, so this is its color at a distance
+  /// of 1; a directional light is this color everywhere.
+  Color color{1, 1, 1};
+};
+
+/// Return the lights of a scene which gives none: the single white point
+/// light at (20, 20, -1) the renderer has always used, as bright at the
+/// origin as it used to be everywhere.
+std::vector<Light> DefaultLights();
+
+/// One light chosen by LightList::sample() to shade a point.
+struct LightSample {
+  /// The vector from the point to the light, not of unit length. For a
+  /// point light the light is at t = 1 along it.
+  Vec3 to_light;
+  /// The far end of a shadow ray along to_light: 1 for a point light,
+  /// infinity for a directional light
+  Real t_max;
+  /// The light arriving at the point, already scaled by the falloff and
+  /// by the weight of the random selection
+  Color color;
+};
+
+/// A LightList prepares the lights of a scene for shading so that the cost
+/// of shading a point does not grow with the number of lights.
+///
+/// Lights are culled per point. A point light's light falls off with the
+/// square of the distance, so past the distance at which its brightest
+/// channel drops below the cutoff it is ignored. The spheres inside which
+/// the point lights matter are sorted into a uniform grid; shading a point
+/// only looks at the lights listed in the point's cell. Directional lights
+/// reach everywhere and are always candidates.
+///
+/// When more than max_samples lights reach a point, max_samples of them are
+/// chosen at random, with the chance of choosing a light proportional to
+/// how bright it is at the point, and each is weighted by the inverse of
+/// that chance. The average over a pixel's samples is the same as shading
+/// with every light (the estimate is unbiased); a scene with hundreds of
+/// small lights costs max_samples shadow rays per hit instead of hundreds.
+/// \code
+/// LightList lights{scene.lights, 1e-3, 8};
+/// std::vector<LightSample> samples;
+/// lights.sample(rec.p, samples);
+/// \endcode
+class LightList {
+ private:
+  /// The point light culling information, one entry per point light
+  struct PointLight {
+    Point3 position;
+    Color color;
+    /// The squared distance past which the light is culled
+    Real radius_squared;
+  };
+  /// The point lights
+  std::vector<PointLight> points_;
+  /// The directional lights which are not culled outright
+  std::vector<Light> directionals_;
+  /// The corner of the grid with the smallest coordinates
+  Point3 grid_min_;
+  /// The number of cells along x, y, and z
+  int cells_[3] = {0, 0, 0};
+  /// The reciprocal of the size of a cell along x, y, and z
+  Vec3 inverse_cell_size_;
+  /// The lights of cell i are cell_lights_[cell_start_[i]] up to
+  /// cell_lights_[cell_start_[i + 1]], indices into points_
+  std::vector<int> cell_start_;
+  /// The concatenated lists of the lights of every cell
+  std::vector<int> cell_lights_;
+  /// The largest number of lights used to shade one point; 0 for no limit
+  int max_samples_;
+  /// False when nothing is culled; the grid is then a single cell which
+  /// covers all of space and holds every point light
+  bool cull_ = true;
+
+  /// Return the index of the cell holding p, or -1 if p is outside the grid
+  int cell(const Point3& p) const;
+
+ public:
+  /// Prepare \p lights for shading.
+  /// \param lights The lights of the scene
+  /// \param cutoff A light whose brightest channel is below this where it
+  /// arrives at a point is not used to shade the point; 0 culls nothing
+  /// \param max_samples The largest number of lights used to shade one
+  /// point, chosen at random when more reach it; 0 for no limit
+  LightList(const std::vector<Light>& lights, double cutoff, int max_samples);
+
+  /// Choose the lights which shade the point \p p, replacing the contents
+  /// of \p samples. The random choice draws from RandomDouble01().
+  /// \param p The point being shaded
+  /// \param samples The chosen lights with their direction and color
+  void sample(const Point3& p, std::vector<LightSample>& samples) const;
+
+  /// Return the number of lights which survived culling outright
+  int size() const;
+};
+
+#endif
@@ -7,28 +7,53 @@
 
 // See the header file for documentation.
 
-Color PhongMaterial::reflect_color(const Ray& r, const HitRecord& rec) const {
-  Vec3 light_position{20, 20, -1};
-  Color light_color{1, 1, 1};
+Color PhongColor(const PhongParameters& material,
+                 const SpecularTable* specular_table, const Ray& r,
+                 const HitRecord& rec, const std::vector<LightSample>& lights) {
+  Color phong = material.ambient;
 
-  Vec3 to_light_vector = UnitVector(light_position - rec.p);
   Vec3 unit_normal = UnitVector(rec.normal);
-  Vec3 to_viewer = UnitVector(-rec.p);
-  Vec3 reflection = Reflect(to_light_vector, unit_normal);
+  Vec3 to_viewer = UnitVector(-r.direction());
+  for (const LightSample& light : lights) {
+    Vec3 to_light_vector = UnitVector(light.to_light);
+    Vec3 reflection = Reflect(to_light_vector, unit_normal);
+
+    Real l_dot_n = std::max(Dot(to_light_vector, unit_normal), Real(0));
+    Color phong_diffuse = material.diffuse * l_dot_n * light.color;
+
+    Real r_dot_v = std::max(Dot(reflection, to_viewer), Real(0));
+    Real r_dot_v_to_alpha = specular_table != nullptr
+                                ? (*specular_table)(r_dot_v)
+                                : Real(std::pow(r_dot_v, material.shininess));
+    Color phong_specular = material.specular * r_dot_v_to_alpha * light.color;
+
+    phong += phong_diffuse + phong_specular;
+  }
+  phong = Clamp(phong, 0, 1);
 
-  Color phong_ambient = ambient_ * light_color;
+  return phong;
+}
 
-  double l_dot_n = std::max(Dot(to_light_vector, unit_normal), 0.0);
-  Color phong_diffuse = diffuse_ * l_dot_n * light_color;
+Color PhongMaterial::reflect_color(const Ray& r, const HitRecord& rec) const {
+  static const LightList lights{DefaultLights(), 0.0, 0};
+  std::vector<LightSample> samples;
+  lights.sample(rec.p, samples);
+  return PhongColor(Materials()[id_], &Materials().specular_table(id_), r,
+                    rec, samples);
+}
 
-  double r_dot_v = std::max(Dot(reflection, to_viewer), 0.0);
-  double r_dot_v_to_alpha = std::pow(r_dot_v, shininess_);
-  Color phong_specular = specular_ * r_dot_v_to_alpha * light_color;
+int PhongMaterial::id() const { return id_; }
 
-  Color phong = phong_ambient + phong_diffuse + phong_specular;
-  phong = Clamp(phong, 0, 1);
+std::string PhongMaterial::name() const { return Materials().name(id_); }
 
-  return phong;
-}
+Color PhongMaterial::ambient() const { return Materials()[id_].ambient; }
+
+Color PhongMaterial::diffuse() const { return Materials()[id_].diffuse; }
 
-std::string PhongMaterial::name() { return name_; }
+Color PhongMaterial::specular() const { return Materials()[id_].specular; }
+
+double PhongMaterial::shininess() const { return Materials()[id_].shininess; }
+
+Color PhongMaterial::reflectance() const {
+  return Materials()[id_].reflectance;
+}
@@ -2,7 +2,12 @@
 #ifndef _MATERIAL_H_
 #define _MATERIAL_H_
 
+#include <string>
+#include <vector>
+
 #include "hittable.h"
+#include "light.h"
+#include "material_table.h"
 #include "ray.h"
 #include "vec3.h"
 
@@ -28,38 +33,70 @@ class Material {
   /// Ray r which intersected the object. Use the material pointer in rec
   /// to calculate the reflected color.
   virtual Color reflect_color(const Ray& r, const HitRecord& rec) const = 0;
+
+  /// The material's ID in the MaterialTable, which is what spheres and hit
+  /// records refer to the material by.
+  virtual int id() const = 0;
 };
 
 /// PhongMaterial is a concrete class which represents a material that
 /// reflects light according to the [Phong Reflection Model]
 /// (https://en.wikipedia.org/wiki/Phong_reflection_model).
-/// The data members store the ambient, diffuse, and specular reflection
-/// colors and the object's shininess. To aide debugging, each material
-/// instance can be given a name.
+/// The ambient, diffuse, and specular reflection colors and the object's
+/// shininess are stored in the MaterialTable returned by Materials(); a
+/// PhongMaterial only holds the material's ID. To aide debugging, each
+/// material can be given a name.
 class PhongMaterial : public Material {
  private:
-  Color ambient_;
-  Color diffuse_;
-  Color specular_;
-  double shininess_;
-  std::string name_;
+  /// The material's ID in Materials()
+  int id_;
 
  public:
   PhongMaterial(const Color& ambient, const Color& diffuse,
                 const Color& specular, double shininess,
-                std::string name = std::string{"No Name"})
-      : ambient_{ambient},
-        diffuse_{diffuse},
-        specular_{specular},
-        shininess_{shininess},
-        name_{name} {};
+                std::string name = std::string{"No Name"},
+                const Color& reflectance = Color{})
+      : id_{Materials().add(PhongParameters{ambient, diffuse, specular,
+                                            shininess, reflectance},
+                            name)} {};
+  /// Refer to the material \p id already in Materials()
+  explicit PhongMaterial(int id) : id_{id} {};
   /// The color that is reflected back at the point stored in rec
-  /// calculated using the Phong Reflection model.
+  /// calculated using the Phong Reflection model. The material knows
+  /// nothing of the rest of the scene so the point is lit by
+  /// DefaultLights() and never in shadow.
   Color reflect_color(const Ray& r, const HitRecord& rec) const override;
+  /// Return the material's ID in Materials()
+  int id() const override;
   /// Return the name of the material. By default, a material is given
   /// the name "No Name" unless a name is provided when the material is
   /// created.
-  std::string name();
+  std::string name() const;
+  /// Return the ambient reflection color
+  Color ambient() const;
+  /// Return the diffuse reflection color
+  Color diffuse() const;
+  /// Return the specular reflection color
+  Color specular() const;
+  /// Return the shininess, the exponent of the specular highlight
+  double shininess() const;
+  /// Return the mirror reflectance; black if the material is not a mirror
+  Color reflectance() const;
 };
 
+/// The color reflected at the hit \p rec of the ray \p r by a material with
+/// the Phong parameters \p material: its ambient color plus the diffuse and
+/// specular reflection of each of the \p lights.
+/// \param material The parameters of the material struck
+/// \param specular_table The material's table of the specular highlight,
+/// see MaterialTable::specular_table(), or null to call std::pow() instead
+/// \param r The ray which struck the material
+/// \param rec The hit
+/// \param lights The lights which reach the hit, such as those chosen by
+/// LightList::sample() less the ones in shadow
+/// \returns The reflected color, clamped to [0, 1]
+Color PhongColor(const PhongParameters& material,
+                 const SpecularTable* specular_table, const Ray& r,
+                 const HitRecord& rec, const std::vector<LightSample>& lights);
+
 #endif
\ No newline at end of file
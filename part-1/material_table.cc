@@ -0,0 +1,58 @@
+#include "material_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+// See the header file for documentation.
+
+const int SpecularTable::kSize;
+constexpr double SpecularTable::kCutoff;
+
+SpecularTable::SpecularTable(double shininess) {
+  double start = shininess > 0 ? std::pow(kCutoff, 1.0 / shininess) : 0.0;
+  double step = (1.0 - start) / kSize;
+  start_ = Real(start);
+  scale_ = Real(1.0 / step);
+  for (int i = 0; i <= kSize; i++) {
+    values_[i] = float(std::pow(start + step * i, shininess));
+  }
+  values_[kSize + 1] = values_[kSize];
+}
+
+const char* const MaterialTable::kNoName = "No Name";
+
+int MaterialTable::add(const PhongParameters& parameters,
+                       const std::string& name) {
+  std::array<double, 13> key{
+      {parameters.ambient.x(), parameters.ambient.y(), parameters.ambient.z(),
+       parameters.diffuse.x(), parameters.diffuse.y(), parameters.diffuse.z(),
+       parameters.specular.x(), parameters.specular.y(),
+       parameters.specular.z(), parameters.shininess,
+       parameters.reflectance.x(), parameters.reflectance.y(),
+       parameters.reflectance.z()}};
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = ids_.emplace(key, int(parameters_.size()));
+  int id = found.first->second;
+  if (found.second) {
+    parameters_.push_back(parameters);
+    specular_tables_.emplace_back(parameters.shininess);
+    names_.push_back(name);
+  } else if (names_[id] == kNoName) {
+    names_[id] = name;
+  }
+  return id;
+}
+
+const std::string& MaterialTable::name(int id) const { return names_[id]; }
+
+int MaterialTable::find(const std::string& name) const {
+  auto found = std::find(names_.begin(), names_.end(), name);
+  return found == names_.end() ? -1 : int(found - names_.begin());
+}
+
+int MaterialTable::size() const { return int(parameters_.size()); }
+
+MaterialTable& Materials() {
+  static MaterialTable table;
+  return table;
+}
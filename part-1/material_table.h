@@ -0,0 +1,139 @@
+#ifndef _MATERIAL_TABLE_H_
+#define _MATERIAL_TABLE_H_
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "vec3.h"
+
+/// The parameters of the [Phong Reflection Model]
+/// (https://en.wikipedia.org/wiki/Phong_reflection_model) for one material:
+/// everything that is read while shading a hit.
+struct PhongParameters {
+  /// The ambient reflection color
+  Color ambient;
+  /// The diffuse reflection color
+  Color diffuse;
+  /// The specular reflection color
+  Color specular;
+  /// The exponent of the specular highlight
+  double shininess = 1.0;
+  /// The fraction of the light arriving from the mirror direction which is
+  /// reflected; black for materials which are not mirrors
+  Color reflectance;
+};
+
+/// A SpecularTable stands in for std::pow(x, shininess), the specular
+/// highlight of the Phong model, with a lookup and a linear interpolation.
+///
+/// x^shininess is tabulated at kSize + 1 evenly spaced points between 1
+/// and the x below which it is under kCutoff and is taken to be 0. The
+/// higher the shininess, the narrower the highlight and the closer the
+/// points, so for any shininess of at least 2 the error is at most
+/// ln(kCutoff)^2 / (8 kSize^2), about 2.5e-4: a sixteenth of one level of
+/// an 8 bit image.
+class SpecularTable {
+ public:
+  /// The number of intervals in the table
+  static const int kSize = 256;
+  /// Values of x^shininess below this are taken to be 0
+  static constexpr double kCutoff = 1e-5;
+
+  /// Tabulate x^\p shininess.
+  explicit SpecularTable(double shininess = 1.0);
+
+  /// Return approximately \p x raised to the shininess, for x in [0, 1].
+  Real operator()(Real x) const {
+    Real position = (x - start_) * scale_;
+    if (!(position > 0)) {
+      return 0;
+    }
+    int i = std::min(int(position), kSize);
+    Real fraction = position - Real(i);
+    return values_[i] + fraction * (values_[i + 1] - values_[i]);
+  }
+
+ private:
+  /// The x of the first entry
+  Real start_;
+  /// The number of entries per unit of x
+  Real scale_;
+  /// x^shininess at each point, and once more for x = 1 so that the
+  /// interpolation at the last entry needs no check
+  std::array<float, kSize + 2> values_;
+};
+
+/// The MaterialTable is the one place the materials of every scene are
+/// kept. Each distinct material is stored once, in a contiguous array of
+/// PhongParameters, and is known everywhere else by its ID: its index in
+/// that array. Spheres and hit records carry the 4 byte ID instead of a
+/// pointer to a heap allocated object, so the parameters of the materials
+/// in use stay packed together in the cache while shading.
+///
+/// Each material also gets a SpecularTable, built when it is added, so
+/// that shading never calls std::pow().
+///
+/// Adding a material whose parameters are identical to one already in the
+/// table returns the existing ID. Names are only needed for printing and
+/// scene files so they are kept in a separate array, out of the way of the
+/// parameters.
+///
+/// Adding materials is thread safe. Looking materials up is not safe while
+/// another thread adds one, which is never the case during rendering since
+/// scenes are built before they are rendered.
+/// \code
+/// int id = Materials().add(PhongParameters{...}, "Brass");
+/// const PhongParameters& brass = Materials()[id];
+/// \endcode
+class MaterialTable {
+ private:
+  /// The parameters of each material, indexed by ID
+  std::vector<PhongParameters> parameters_;
+  /// The specular highlight table of each material, indexed by ID
+  std::vector<SpecularTable> specular_tables_;
+  /// The name of each material, indexed by ID
+  std::vector<std::string> names_;
+  /// The ID of each distinct set of parameters
+  std::map<std::array<double, 13>, int> ids_;
+  /// Serializes calls to add()
+  std::mutex mutex_;
+
+ public:
+  /// The name given to a material added without one
+  static const char* const kNoName;
+
+  /// Add a material to the table, or find the identical one already in it.
+  /// A material first added without a name takes the name given when it is
+  /// added again.
+  /// \param parameters The material's Phong parameters
+  /// \param name The material's name
+  /// \returns The material's ID
+  int add(const PhongParameters& parameters,
+          const std::string& name = kNoName);
+
+  /// Return the parameters of the material \p id
+  const PhongParameters& operator[](int id) const { return parameters_[id]; }
+
+  /// Return the specular highlight table of the material \p id
+  const SpecularTable& specular_table(int id) const {
+    return specular_tables_[id];
+  }
+
+  /// Return the name of the material \p id
+  const std::string& name(int id) const;
+
+  /// Return the ID of the material called \p name, or -1 if there is none
+  int find(const std::string& name) const;
+
+  /// Return the number of distinct materials in the table
+  int size() const;
+};
+
+/// Return the table holding every material in the program.
+MaterialTable& Materials();
+
+#endif
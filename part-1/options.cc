@@ -0,0 +1,361 @@
+#include "options.h"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+// See the header file for documentation.
+
+namespace {
+// The largest width or height of an image, in pixels.
+const int kMaxImageSize = 65536;
+
+// Convert text into an integer; returns false if text is not a whole number.
+bool ToInteger(const std::string& text, long long& value) {
+  if (text.empty()) {
+    return false;
+  }
+  char* end = nullptr;
+  errno = 0;
+  value = std::strtoll(text.c_str(), &end, 10);
+  return errno == 0 && *end == '\0';
+}
+
+// Convert text into a floating point number.
+bool ToDouble(const std::string& text, double& value) {
+  if (text.empty()) {
+    return false;
+  }
+  char* end = nullptr;
+  errno = 0;
+  value = std::strtod(text.c_str(), &end);
+  return errno == 0 && *end == '\0';
+}
+
+// Convert text into an unsigned 64 bit integer.
+bool ToUnsigned(const std::string& text, std::uint64_t& value) {
+  if (text.empty() || text[0] == '-') {
+    return false;
+  }
+  char* end = nullptr;
+  errno = 0;
+  value = std::strtoull(text.c_str(), &end, 10);
+  return errno == 0 && *end == '\0';
+}
+// Convert text such as 1,2.5,-3 into a vector.
+bool ToVec3(const std::string& text, Vec3& value) {
+  std::size_t first = text.find(',');
+  std::size_t second =
+      first == std::string::npos ? first : text.find(',', first + 1);
+  if (second == std::string::npos) {
+    return false;
+  }
+  double x = 0;
+  double y = 0;
+  double z = 0;
+  if (!ToDouble(text.substr(0, first), x) ||
+      !ToDouble(text.substr(first + 1, second - first - 1), y) ||
+      !ToDouble(text.substr(second + 1), z)) {
+    return false;
+  }
+  value = Vec3{x, y, z};
+  return true;
+}
+
+// The aspect ratio of the image: the one given on the command line, or
+// else 16:9.
+double AspectRatio(const Options& options) {
+  const double kDefaultAspectRatio = 16.0 / 9.0;
+  return options.camera.aspect_ratio > 0.0 ? options.camera.aspect_ratio
+                                           : kDefaultAspectRatio;
+}
+}  // namespace
+
+std::string Usage(const std::string& program_name) {
+  std::ostringstream usage;
+  usage << "Usage: " << program_name << " output_file [options]\n"
+        << "  --threads N   Number of rendering threads (default: all)\n"
+        << "  --seed S      Seed for reproducible scenes and images\n"
+        << "  --format F    Image format: p6 (default), p3, p6-16, or pfm\n"
+        << "  --width W     Image width in pixels (default 800)\n"
+        << "  --height H    Image height in pixels (default: width / aspect)\n"
+        << "  --aspect A    Aspect ratio of the view and, unless --height is\n"
+        << "                given, of the image (default 16/9)\n"
+        << "  --look-from X,Y,Z\n"
+        << "                Camera position (default 0,0,0)\n"
+        << "  --look-at X,Y,Z\n"
+        << "                Point the camera looks at (default 0,0,-1)\n"
+        << "  --up X,Y,Z    Camera up direction (default 0,1,0)\n"
+        << "  --fov DEGREES Vertical field of view (default 90)\n"
+        << "  --scene FILE  Render the scene in FILE, text or binary\n"
+        << "  --spheres N   Number of random spheres in the scene made when\n"
+        << "                no --scene is given (default 100)\n"
+        << "  --min-radius R, --max-radius R\n"
+        << "                Radii of the random spheres (default 0.25)\n"
+        << "  --density D   Spread the random spheres out to fill the\n"
+        << "                fraction D of their region (default: 10x10x7)\n"
+        << "  --no-overlap  Place the random spheres so that none overlap\n"
+        << "  --accel A     Structure built over the scene: bvh (default),\n"
+        << "                lbvh (a linear BVH, quicker to build) or grid\n"
+        << "  --save-scene FILE\n"
+        << "                Write the scene to FILE as text\n"
+        << "  --save-cache FILE\n"
+        << "                Write the scene to FILE in the binary format,\n"
+        << "                which --scene loads much faster\n"
+        << "  --spp N       Largest number of samples per pixel (default 50)\n"
+        << "  --min-spp N   Samples per pixel before adaptive sampling may\n"
+        << "                stop (default 8)\n"
+        << "  --noise T     Adaptive sampling noise threshold, such as\n"
+        << "                0.01; 0 takes every sample (default 0)\n"
+        << "  --passes P    Refine the image progressively in P passes,\n"
+        << "                rewriting the file after each one (default 1)\n"
+        << "  --no-shadows  Light every point as if nothing blocked the light\n"
+        << "  --light-cutoff B\n"
+        << "                Ignore lights dimmer than B where they reach a\n"
+        << "                point, 0 to use every light (default 0.001)\n"
+        << "  --light-samples N\n"
+        << "                Shade each point with at most N lights, chosen at\n"
+        << "                random, 0 for every light (default 8)\n"
+        << "  --max-depth D Follow at most D mirror reflections, 0 for none\n"
+        << "                (default 8)\n"
+        << "  --roulette-depth R\n"
+        << "                Follow R reflections before ending dim paths at\n"
+        << "                random (default 2)\n"
+        << "  --stats       Print the time of each phase and counts of the\n"
+        << "                rays traced, tests made and hits shaded\n"
+        << "  --stats-json FILE\n"
+        << "                Write the same figures to FILE as JSON\n";
+  return usage.str();
+}
+
+bool ParseOptions(int argc, char const* argv[], Options& options,
+                  std::string& error) {
+  for (int i = 1; i < argc; i++) {
+    std::string argument{argv[i]};
+    bool has_value = i + 1 < argc;
+    if (argument == "--threads") {
+      long long threads = 0;
+      if (!has_value || !ToInteger(argv[++i], threads) || threads < 0) {
+        error = "--threads needs a number of threads, 0 for all.";
+        return false;
+      }
+      options.threads = int(threads);
+    } else if (argument == "--seed") {
+      if (!has_value || !ToUnsigned(argv[++i], options.seed)) {
+        error = "--seed needs a non-negative whole number.";
+        return false;
+      }
+      options.has_seed = true;
+    } else if (argument == "--spp" || argument == "--min-spp" ||
+               argument == "--passes") {
+      long long count = 0;
+      if (!has_value || !ToInteger(argv[++i], count) || count < 1 ||
+          count > 1000000) {
+        error = argument + " needs a positive whole number.";
+        return false;
+      }
+      if (argument == "--spp") {
+        options.samples_per_pixel = int(count);
+      } else if (argument == "--min-spp") {
+        options.min_samples_per_pixel = int(count);
+      } else {
+        options.passes = int(count);
+      }
+    } else if (argument == "--noise") {
+      if (!has_value || !ToDouble(argv[++i], options.noise_threshold) ||
+          options.noise_threshold < 0) {
+        error = "--noise needs a threshold of 0 or more.";
+        return false;
+      }
+    } else if (argument == "--light-cutoff") {
+      if (!has_value || !ToDouble(argv[++i], options.light_cutoff) ||
+          options.light_cutoff < 0) {
+        error = "--light-cutoff needs a brightness of 0 or more.";
+        return false;
+      }
+    } else if (argument == "--light-samples") {
+      long long count = 0;
+      if (!has_value || !ToInteger(argv[++i], count) || count < 0 ||
+          count > 1000000) {
+        error = "--light-samples needs a number of lights, 0 for all.";
+        return false;
+      }
+      options.light_samples = int(count);
+    } else if (argument == "--spheres") {
+      long long count = 0;
+      if (!has_value || !ToInteger(argv[++i], count) || count < 0 ||
+          count > 100000000) {
+        error = "--spheres needs a number of spheres, 0 or more.";
+        return false;
+      }
+      options.num_spheres = int(count);
+    } else if (argument == "--min-radius" || argument == "--max-radius" ||
+               argument == "--density") {
+      double value = 0;
+      if (!has_value || !ToDouble(argv[++i], value) || !(value > 0) ||
+          (argument == "--density" && !(value < 1))) {
+        error = argument == "--density"
+                    ? "--density needs a fraction between 0 and 1."
+                    : argument + " needs a positive radius.";
+        return false;
+      }
+      if (argument == "--min-radius") {
+        options.min_radius = value;
+      } else if (argument == "--max-radius") {
+        options.max_radius = value;
+      } else {
+        options.density = value;
+      }
+    } else if (argument == "--no-overlap") {
+      options.no_overlap = true;
+    } else if (argument == "--accel") {
+      std::string name = has_value ? argv[++i] : "";
+      if (name == "bvh") {
+        options.acceleration = Acceleration::kBVH;
+      } else if (name == "lbvh") {
+        options.acceleration = Acceleration::kLinearBVH;
+      } else if (name == "grid") {
+        options.acceleration = Acceleration::kGrid;
+      } else {
+        error = "--accel needs one of bvh, lbvh or grid.";
+        return false;
+      }
+    } else if (argument == "--max-depth" || argument == "--roulette-depth") {
+      long long depth = 0;
+      if (!has_value || !ToInteger(argv[++i], depth) || depth < 0 ||
+          depth > 1000) {
+        error = argument + " needs a number of reflections, 0 or more.";
+        return false;
+      }
+      if (argument == "--max-depth") {
+        options.max_depth = int(depth);
+      } else {
+        options.roulette_depth = int(depth);
+      }
+    } else if (argument == "--scene" || argument == "--save-scene" ||
+               argument == "--save-cache" || argument == "--stats-json") {
+      if (!has_value) {
+        error = argument + " needs a file name.";
+        return false;
+      }
+      std::string file_name{argv[++i]};
+      if (argument == "--scene") {
+        options.scene_file_name = file_name;
+      } else if (argument == "--save-scene") {
+        options.save_scene_file_name = file_name;
+      } else if (argument == "--stats-json") {
+        options.stats_file_name = file_name;
+      } else {
+        options.save_cache_file_name = file_name;
+      }
+    } else if (argument == "--width" || argument == "--height") {
+      long long size = 0;
+      if (!has_value || !ToInteger(argv[++i], size) || size < 2 ||
+          size > kMaxImageSize) {
+        error = argument + " needs a number of pixels from 2 to " +
+                std::to_string(kMaxImageSize) + ".";
+        return false;
+      }
+      (argument == "--width" ? options.width : options.height) = int(size);
+    } else if (argument == "--aspect" || argument == "--fov") {
+      double value = 0;
+      if (!has_value || !ToDouble(argv[++i], value) || !(value > 0) ||
+          !std::isfinite(value) || (argument == "--fov" && !(value < 180))) {
+        error = argument == "--aspect"
+                    ? "--aspect needs a positive, finite ratio."
+                    : "--fov needs an angle between 0 and 180 degrees.";
+        return false;
+      }
+      if (argument == "--aspect") {
+        options.camera.aspect_ratio = value;
+      } else {
+        options.camera.vertical_fov = value;
+        options.has_fov = true;
+      }
+    } else if (argument == "--look-from" || argument == "--look-at" ||
+               argument == "--up") {
+      Vec3 value;
+      if (!has_value || !ToVec3(argv[++i], value)) {
+        error = argument + " needs a point such as 0,1,-2.";
+        return false;
+      }
+      if (argument == "--look-from") {
+        options.camera.position = value;
+        options.has_look_from = true;
+      } else if (argument == "--look-at") {
+        options.camera.look_at = value;
+        options.has_look_at = true;
+      } else {
+        options.camera.up = value;
+        options.has_up = true;
+      }
+    } else if (argument == "--no-shadows") {
+      options.shadows = false;
+    } else if (argument == "--stats") {
+      options.print_stats = true;
+    } else if (argument == "--format") {
+      if (!has_value || !ImageFormatFromName(argv[++i], options.format)) {
+        error = "--format needs one of p6, p3, p6-16, or pfm.";
+        return false;
+      }
+    } else if (argument.size() > 1 && argument[0] == '-') {
+      error = "Unknown option " + argument + ".";
+      return false;
+    } else if (options.output_file_name.empty()) {
+      options.output_file_name = argument;
+    } else {
+      error = "Unexpected argument " + argument + ".";
+      return false;
+    }
+  }
+  if (options.output_file_name.empty()) {
+    error = "Please provide a path to a file.";
+    return false;
+  }
+  if (options.height == 0) {
+    // The height is checked before it is rounded to an int, which an
+    // extreme aspect ratio would overflow.
+    double height = std::round(options.width / AspectRatio(options));
+    if (!(height >= 2 && height <= kMaxImageSize)) {
+      error = "The aspect ratio leaves the image less than 2 or more than " +
+              std::to_string(kMaxImageSize) + " pixels high.";
+      return false;
+    }
+  }
+  if (options.passes > options.samples_per_pixel) {
+    error = "--passes needs no more passes than samples per pixel (50 "
+            "unless --spp is given).";
+    return false;
+  }
+  if (options.min_radius > options.max_radius) {
+    error = "The smallest radius is larger than the largest (0.25 unless "
+            "--min-radius and --max-radius are given).";
+    return false;
+  }
+  return true;
+}
+
+int ImageHeight(const Options& options) {
+  if (options.height > 0) {
+    return options.height;
+  }
+  return int(std::lround(options.width / AspectRatio(options)));
+}
+
+CameraView CameraFromOptions(const Options& options, CameraView view) {
+  if (options.has_look_from) {
+    view.position = options.camera.position;
+  }
+  if (options.has_look_at) {
+    view.look_at = options.camera.look_at;
+  }
+  if (options.has_up) {
+    view.up = options.camera.up;
+  }
+  if (options.has_fov) {
+    view.vertical_fov = options.camera.vertical_fov;
+  }
+  view.aspect_ratio = options.camera.aspect_ratio;
+  return view;
+}
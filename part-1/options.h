@@ -0,0 +1,125 @@
+#ifndef _OPTIONS_H_
+#define _OPTIONS_H_
+
+#include <cstdint>
+#include <string>
+
+#include "camera.h"
+#include "image.h"
+
+/// The structures the ray tracer can build over the scene to find the
+/// objects a ray strikes
+enum class Acceleration {
+  /// A BVH, see BVH; the default, and the best choice for most scenes
+  kBVH,
+  /// A linear BVH, built from Morton codes; much faster to build than
+  /// kBVH and somewhat slower to trace
+  kLinearBVH,
+  /// A uniform grid, see Grid; for many evenly spread spheres of similar
+  /// size
+  kGrid,
+};
+
+/// Options given to the ray tracer on the command line.
+/// The only required argument is the path to the output image; everything
+/// else has a sensible default.
+/// \code
+/// rt output.ppm --threads 8 --seed 42
+/// \endcode
+struct Options {
+  /// The path to the image file to create
+  std::string output_file_name;
+  /// The scene file to render; empty for the built in random scene
+  std::string scene_file_name;
+  /// The number of random spheres in the built in random scene
+  int num_spheres = 100;
+  /// The smallest and largest radius of the random spheres
+  double min_radius = 0.25;
+  double max_radius = 0.25;
+  /// The fraction of its region the random spheres fill; 0 for the usual
+  /// region
+  double density = 0.0;
+  /// True to place the random spheres so that none overlap
+  bool no_overlap = false;
+  /// The structure built over the scene
+  Acceleration acceleration = Acceleration::kBVH;
+  /// If not empty, the scene is written to this file in the text format
+  std::string save_scene_file_name;
+  /// If not empty, the scene is written to this file in the binary format
+  std::string save_cache_file_name;
+  /// True to print the phase times and counters once the image is written
+  bool print_stats = false;
+  /// If not empty, the phase times and counters are written to this file
+  /// as JSON
+  std::string stats_file_name;
+  /// The width of the image in pixels
+  int width = 800;
+  /// The height of the image in pixels; 0 sets it from the width and the
+  /// aspect ratio
+  int height = 0;
+  /// The camera settings given on the command line
+  CameraView camera;
+  /// True if the camera position was given on the command line
+  bool has_look_from = false;
+  /// True if the point the camera looks at was given on the command line
+  bool has_look_at = false;
+  /// True if the camera's up direction was given on the command line
+  bool has_up = false;
+  /// True if the field of view was given on the command line
+  bool has_fov = false;
+  /// The format of the image file
+  ImageFormat format = ImageFormat::kP6;
+  /// The largest number of samples taken through each pixel
+  int samples_per_pixel = 50;
+  /// The number of samples every pixel gets before adaptive sampling may
+  /// stop it
+  int min_samples_per_pixel = 8;
+  /// The adaptive sampling noise threshold; 0, as in RenderSettings,
+  /// samples every pixel fully
+  double noise_threshold = 0.0;
+  /// The number of progressive passes, at most samples_per_pixel; the
+  /// image file is rewritten after each pass
+  int passes = 1;
+  /// True to trace shadow rays toward the lights
+  bool shadows = true;
+  /// Lights dimmer than this where they reach a point do not shade it
+  double light_cutoff = 1e-3;
+  /// The largest number of lights used to shade a point; 0 for all
+  int light_samples = 8;
+  /// The largest number of mirror reflections followed from a camera ray
+  int max_depth = 8;
+  /// The number of reflections always followed before Russian roulette
+  /// may end a path
+  int roulette_depth = 2;
+  /// The number of rendering threads; 0 means one per hardware thread
+  int threads = 0;
+  /// The seed for every random number used to build and render the scene
+  std::uint64_t seed = 0;
+  /// True if the seed was given on the command line
+  bool has_seed = false;
+};
+
+/// Return a short description of the command line arguments.
+/// \param program_name The name the program was invoked with (argv[0])
+/// \returns A usage message suitable for printing to the terminal
+std::string Usage(const std::string& program_name);
+
+/// Return the height of the image: the height given on the command line,
+/// or else the width divided by the aspect ratio (16:9 unless given).
+int ImageHeight(const Options& options);
+
+/// Return \p view with the parts of the camera given on the command line
+/// replaced. The scene's camera is passed in so the command line can
+/// override it.
+CameraView CameraFromOptions(const Options& options, CameraView view);
+
+/// Parse the command line arguments \p argv into \p options.
+/// \param argc The number of arguments in \p argv
+/// \param argv The arguments given to main()
+/// \param options The options to update with the parsed values
+/// \param error A description of the problem when parsing fails
+/// \returns true if the arguments were parsed else false
+bool ParseOptions(int argc, char const* argv[], Options& options,
+                  std::string& error);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/// Return the number of threads to use when \p threads are asked for: all
+/// of the hardware threads for 0, else \p threads.
+inline int ThreadCount(int threads) {
+  if (threads <= 0) {
+    return int(std::max(1U, std::thread::hardware_concurrency()));
+  }
+  return threads;
+}
+
+/// Call body(begin, end) for the blocks of \p block_size items that make up
+/// [0, count), on a pool of up to \p threads threads (0 for all of the
+/// hardware threads). The calling thread is one of the pool. Threads take
+/// the next block as they finish one, so blocks of uneven cost balance out;
+/// body must be safe to call for different blocks at once.
+/// \code
+/// ParallelFor(n, 0, 4096, [&](int begin, int end) {
+///   for (int i = begin; i < end; i++) {
+///     boxes[i] = spheres.bounding_box(i);
+///   }
+/// });
+/// \endcode
+template <typename Body>
+void ParallelFor(int count, int threads, int block_size, Body body) {
+  int num_blocks = (count + block_size - 1) / block_size;
+  threads = std::max(1, std::min(ThreadCount(threads), num_blocks));
+  std::atomic<int> next_block{0};
+  auto worker = [&]() {
+    for (int block = next_block++; block < num_blocks; block = next_block++) {
+      int begin = block * block_size;
+      body(begin, std::min(begin + block_size, count));
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+
+#endif
@@ -0,0 +1,254 @@
+#include "random_scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "parallel.h"
+#include "rng.h"
+#include "utility.h"
+
+// See the header file for documentation.
+
+namespace {
+// The number of spheres in a block; each block has its own random sequence.
+const int kBlockSize = 16384;
+// The volume of the region at its usual size: x and y in [-5, 5] and z in
+// [-10, -3].
+const double kRegionVolume = 10.0 * 10.0 * 7.0;
+
+// The spheres of the scene in the layout SphereSet::assign() takes.
+struct SphereArrays {
+  std::vector<double> x;
+  std::vector<double> y;
+  std::vector<double> z;
+  std::vector<double> radius;
+  std::vector<int> material_id;
+
+  void resize(std::size_t n) {
+    x.resize(n);
+    y.resize(n);
+    z.resize(n);
+    radius.resize(n);
+    material_id.resize(n);
+  }
+};
+
+// The factor by which the region is scaled so that num_random spheres
+// fill the fraction settings.density of it.
+double RegionScale(const RandomSceneSettings& settings, int num_random) {
+  if (!(settings.density > 0) || num_random == 0) {
+    return 1.0;
+  }
+  double a = settings.min_radius;
+  double b = settings.max_radius;
+  // The mean of r^3 for r spread evenly over [a, b]
+  double mean_cube = b > a ? (b * b * b * b - a * a * a * a) / (4 * (b - a))
+                           : a * a * a;
+  double volume = num_random * 4.0 / 3.0 * kPi * mean_cube / settings.density;
+  return std::cbrt(volume / kRegionVolume);
+}
+
+double RandomRadius(const RandomSceneSettings& settings, Xoshiro256& engine) {
+  return settings.min_radius +
+         (settings.max_radius - settings.min_radius) * engine.next_double();
+}
+
+// Scatter num_random spheres, which may overlap, into spheres from index
+// first on, a block at a time on a pool of threads.
+void Scatter(const RandomSceneSettings& settings, int num_random,
+             double scale, const std::vector<int>& materials, int first,
+             SphereArrays& spheres) {
+  auto scatter_block = [&](int begin, int end) {
+    Xoshiro256 engine{MixSeed(settings.seed,
+                              std::uint64_t(begin / kBlockSize))};
+    for (int i = begin; i < end; i++) {
+      // A random direction, scaled by a random distance along it, pushed a
+      // random distance in front of the camera.
+      double theta = 2 * kPi * engine.next_double();
+      double phi = std::acos(1 - 2 * engine.next_double());
+      double distance = scale * (-5 + 10 * engine.next_double());
+      double depth = -3 - scale * 7 * engine.next_double();
+      std::size_t k = std::size_t(first) + std::size_t(i);
+      spheres.x[k] = distance * std::sin(phi) * std::cos(theta);
+      spheres.y[k] = distance * std::sin(phi) * std::sin(theta);
+      spheres.z[k] = distance * std::cos(phi) + depth;
+      spheres.radius[k] = RandomRadius(settings, engine);
+      spheres.material_id[k] = materials[std::size_t(i) % materials.size()];
+    }
+  };
+  ParallelFor(num_random, settings.threads, kBlockSize, scatter_block);
+}
+
+// Place up to num_random spheres which do not overlap each other or the
+// spheres before index first, the markers, into spheres from index first
+// on, drawing from engine. Returns the number placed.
+int PlaceWithoutOverlaps(const RandomSceneSettings& settings, int num_random,
+                         double scale, const std::vector<int>& materials,
+                         int first, Xoshiro256& engine,
+                         SphereArrays& spheres) {
+  // The region is a box in front of the camera.
+  Point3 low{-5 * scale, -5 * scale, -3 - 7 * scale};
+  Vec3 size{10 * scale, 10 * scale, 7 * scale};
+  // A sphere can only overlap spheres whose centers are in its own cell
+  // or in one of the 26 around it.
+  double cell_size = 2 * settings.max_radius;
+  // The spatial hash maps a cell to a bucket: a list of the spheres in the
+  // cells which hash to it, linked through Entry::next. Neighbors along x
+  // hash to neighboring buckets so that the three cells of a row around a
+  // sphere share a cache line, and the placed spheres are copied into the
+  // entries so that checking one costs a single cache miss.
+  struct Entry {
+    double x;
+    double y;
+    double z;
+    double radius;
+    int next;
+  };
+  std::size_t num_buckets = 1;
+  while (num_buckets < 2 * std::size_t(num_random)) {
+    num_buckets *= 2;
+  }
+  std::vector<int> head(num_buckets, -1);
+  std::vector<Entry> entries;
+  entries.reserve(num_random);
+  auto row = [](long long j, long long k) {
+    return MixSeed(std::uint64_t(j), std::uint64_t(k));
+  };
+  auto bucket = [num_buckets](std::uint64_t row, long long i) {
+    return std::size_t((row + std::uint64_t(i)) & (num_buckets - 1));
+  };
+  auto cell = [&](double v, int axis) {
+    return (long long)std::floor((v - low[axis]) / cell_size);
+  };
+
+  // Every sphere's first place is drawn up front, and the spheres are
+  // placed in the order of those places' cells, a row of cells at a time.
+  // The cells one sphere checks were then mostly just checked for the
+  // sphere before it and are still in the cache. Only a sphere whose first
+  // place is taken goes on to try places at random.
+  struct Candidate {
+    std::uint64_t key;
+    double p[3];
+    double radius;
+  };
+  std::uint64_t cells[3];
+  for (int axis = 0; axis < 3; axis++) {
+    cells[axis] = std::uint64_t(size[axis] / cell_size) + 1;
+  }
+  std::vector<Candidate> candidates(num_random);
+  for (Candidate& candidate : candidates) {
+    candidate.radius = RandomRadius(settings, engine);
+    for (int axis = 0; axis < 3; axis++) {
+      candidate.p[axis] = low[axis] + size[axis] * engine.next_double();
+    }
+    candidate.key =
+        (std::uint64_t(cell(candidate.p[2], 2)) * cells[1] +
+         std::uint64_t(cell(candidate.p[1], 1))) * cells[0] +
+        std::uint64_t(cell(candidate.p[0], 0));
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate& a, const Candidate& b) {
+                     return a.key < b.key;
+                   });
+
+  int placed = 0;
+  for (const Candidate& candidate : candidates) {
+    double radius = candidate.radius;
+    for (int attempt = 0; attempt < settings.max_attempts; attempt++) {
+      double p[3];
+      long long c[3];
+      for (int axis = 0; axis < 3; axis++) {
+        p[axis] = attempt == 0 ? candidate.p[axis]
+                               : low[axis] + size[axis] * engine.next_double();
+        c[axis] = cell(p[axis], axis);
+      }
+      // The markers can be larger than a cell, so rather than going into
+      // the hash they are each checked against every place tried.
+      bool overlaps = false;
+      for (int s = 0; s < first && !overlaps; s++) {
+        double ox = p[0] - spheres.x[s];
+        double oy = p[1] - spheres.y[s];
+        double oz = p[2] - spheres.z[s];
+        double reach = radius + spheres.radius[s];
+        overlaps = ox * ox + oy * oy + oz * oz < reach * reach;
+      }
+      for (int dz = -1; dz <= 1 && !overlaps; dz++) {
+        for (int dy = -1; dy <= 1 && !overlaps; dy++) {
+          std::uint64_t r = row(c[1] + dy, c[2] + dz);
+          for (int dx = -1; dx <= 1 && !overlaps; dx++) {
+            std::size_t b = bucket(r, c[0] + dx);
+            for (int s = head[b]; s >= 0; s = entries[s].next) {
+              const Entry& e = entries[s];
+              double ox = p[0] - e.x;
+              double oy = p[1] - e.y;
+              double oz = p[2] - e.z;
+              double reach = radius + e.radius;
+              if (ox * ox + oy * oy + oz * oz < reach * reach) {
+                overlaps = true;
+                break;
+              }
+            }
+          }
+        }
+      }
+      if (overlaps) {
+        continue;
+      }
+      std::size_t k = std::size_t(first) + std::size_t(placed);
+      spheres.x[k] = p[0];
+      spheres.y[k] = p[1];
+      spheres.z[k] = p[2];
+      spheres.radius[k] = radius;
+      spheres.material_id[k] =
+          materials[std::size_t(placed) % materials.size()];
+      std::size_t b = bucket(row(c[1], c[2]), c[0]);
+      entries.push_back(Entry{p[0], p[1], p[2], radius, head[b]});
+      head[b] = placed;
+      placed++;
+      break;
+    }
+  }
+  return placed;
+}
+}  // namespace
+
+int GenerateRandomScene(const RandomSceneSettings& settings, Scene& scene) {
+  std::vector<std::shared_ptr<Hittable>> markers;
+  FiveSpheres(markers);
+  int num_markers = int(markers.size());
+  int num_random = std::max(0, settings.num_spheres);
+  SphereArrays spheres;
+  spheres.resize(std::size_t(num_markers) + std::size_t(num_random));
+  for (int i = 0; i < num_markers; i++) {
+    const Sphere& sphere = *std::static_pointer_cast<Sphere>(markers[i]);
+    spheres.x[i] = sphere.center().x();
+    spheres.y[i] = sphere.center().y();
+    spheres.z[i] = sphere.center().z();
+    spheres.radius[i] = sphere.radius();
+    spheres.material_id[i] = sphere.material_id();
+  }
+
+  // The random spheres take the materials in a shuffled order.
+  std::vector<int> materials;
+  for (const auto& material : make_phong_material_array()) {
+    materials.push_back(material->id());
+  }
+  Xoshiro256 engine{settings.seed};
+  std::shuffle(materials.begin(), materials.end(), engine);
+
+  double scale = RegionScale(settings, num_random);
+  int placed = num_random;
+  if (settings.no_overlap) {
+    placed = PlaceWithoutOverlaps(settings, num_random, scale, materials,
+                                  num_markers, engine, spheres);
+    spheres.resize(std::size_t(num_markers) + std::size_t(placed));
+  } else {
+    Scatter(settings, num_random, scale, materials, num_markers, spheres);
+  }
+  scene.spheres.assign(int(spheres.x.size()), spheres.x.data(),
+                       spheres.y.data(), spheres.z.data(),
+                       spheres.radius.data(), spheres.material_id.data());
+  return placed;
+}
@@ -0,0 +1,71 @@
+#ifndef _RANDOM_SCENE_H_
+#define _RANDOM_SCENE_H_
+
+#include <cstdint>
+
+#include "scene.h"
+
+/// The settings of GenerateRandomScene().
+struct RandomSceneSettings {
+  /// The number of random spheres, in addition to the five large marker
+  /// spheres every random scene has
+  int num_spheres = 100;
+  /// The seed every sphere is drawn from
+  std::uint64_t seed = 0;
+  /// The number of threads generating spheres; 0 means one per hardware
+  /// thread
+  int threads = 0;
+  /// The radii of the random spheres are spread evenly over
+  /// [min_radius, max_radius], where 0 < min_radius <= max_radius
+  double min_radius = 0.25;
+  double max_radius = 0.25;
+  /// The fraction of the region's volume the random spheres fill. The
+  /// region is scaled to suit; 0 leaves it at its usual size, a 10 by 10 by
+  /// 7 box in front of the camera.
+  double density = 0.0;
+  /// When true, no random sphere overlaps another or a marker sphere. Each
+  /// sphere is dropped at a random point of the region and moved to
+  /// another until it overlaps neither the markers nor anything placed
+  /// before it, at most max_attempts times; a sphere which finds no room
+  /// is left out.
+  bool no_overlap = false;
+  /// The number of places tried for each sphere when no_overlap is true
+  int max_attempts = 32;
+};
+
+/// Fill \p scene with a random scene like RandomScene()'s: the five marker
+/// spheres of FiveSpheres() and num_spheres spheres scattered in front of
+/// the camera, each with one of the materials of
+/// make_phong_material_array().
+///
+/// The spheres are written straight into arrays in the layout of SphereSet,
+/// sized up front, with no Sphere objects, no shared pointers and no
+/// printing. The random spheres are generated in blocks of kBlockSize on a
+/// pool of threads; each block draws from its own sequence, derived from
+/// the seed and the block's number, so the scene is the same whatever the
+/// number of threads.
+///
+/// Without overlaps the spheres are placed one after the other, since each
+/// depends on the ones before it, by rejection sampling. The spheres
+/// already placed are kept in a spatial hash of cells as wide as the
+/// largest sphere, so a new sphere only needs checking against the spheres
+/// in the 27 cells around it, and against each of the five markers, which
+/// may be larger than a cell. Placing N spheres takes time in proportion
+/// to N.
+/// \code
+/// Scene scene;
+/// RandomSceneSettings settings;
+/// settings.num_spheres = 1000000;
+/// settings.no_overlap = true;
+/// GenerateRandomScene(settings, scene);
+/// BVH world{scene.spheres};
+/// \endcode
+/// \param settings The number, size and placement of the spheres, the seed
+/// and the threads
+/// \param scene The scene whose spheres are replaced; the camera and the
+/// lights are left as they are
+/// \returns The number of random spheres placed, fewer than num_spheres
+/// only when no_overlap is true and the region filled up
+int GenerateRandomScene(const RandomSceneSettings& settings, Scene& scene);
+
+#endif
@@ -45,7 +45,7 @@ class Ray {
   Vec3 direction() const;
 
   /// Evaluate the ray at \p t and return the point that the ray points to
-  /// Given a double \p t, evaluate (plug in) the value into the ray equation
+  /// Given a Real \p t, evaluate (plug in) the value into the ray equation
   /// and calculate the point that the ray points to.
   /// P(t) = O + td
   /// P(t) is the point at value t
@@ -54,7 +54,7 @@ class Ray {
   /// d is the direction
   /// \param t A positive or negative floating point value
   /// \returns A 3D point that the ray points at.
-  Point3 at(double t) const;
+  Point3 at(Real t) const;
 };
 
 /// Output a ray to an ostream
@@ -0,0 +1,35 @@
+#include "ray_packet.h"
+
+#include <limits>
+
+// See the header file for documentation.
+
+RayPacket::RayPacket() {
+  // Empty lanes hold a harmless ray that nothing can be hit along.
+  for (int lane = 0; lane < kPacketSize; lane++) {
+    for (int axis = 0; axis < 3; axis++) {
+      origin[axis][lane] = 0.0;
+      direction[axis][lane] = 1.0;
+      inverse_direction[axis][lane] = 1.0;
+    }
+    t_max[lane] = -std::numeric_limits<Real>::infinity();
+  }
+}
+
+void RayPacket::set(int lane, const Ray& r, Real t_max) {
+  Point3 o = r.origin();
+  Vec3 d = r.direction();
+  for (int axis = 0; axis < 3; axis++) {
+    origin[axis][lane] = o[axis];
+    direction[axis][lane] = d[axis];
+    inverse_direction[axis][lane] = 1.0 / d[axis];
+  }
+  this->t_max[lane] = t_max;
+  active |= 1 << lane;
+}
+
+Ray RayPacket::ray(int lane) const {
+  return Ray{Point3{origin[0][lane], origin[1][lane], origin[2][lane]},
+             Vec3{direction[0][lane], direction[1][lane],
+                  direction[2][lane]}};
+}
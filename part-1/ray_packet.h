@@ -0,0 +1,42 @@
+#ifndef _RAY_PACKET_H_
+#define _RAY_PACKET_H_
+
+#include "ray.h"
+#include "vec3.h"
+
+/// The number of rays traced together in a RayPacket
+const int kPacketSize = 4;
+
+/// A RayPacket holds kPacketSize rays which are traced through the scene
+/// together. Camera rays through neighboring pixels travel in almost the
+/// same direction and visit almost the same BVH nodes, so testing a node
+/// or a sphere once for the whole packet, with the rays in SIMD lanes,
+/// saves most of the work of tracing the rays one at a time.
+///
+/// The rays are stored as a structure of arrays: origin[0] holds the x
+/// coordinate of every ray's origin, origin[1] the y coordinates, and so
+/// on. A lane which does not hold a ray has a t_max below any t_min so it
+/// can never hit anything; the lanes in use are recorded in active.
+struct RayPacket {
+  /// The x, y, and z coordinates of each ray's origin
+  alignas(32) Real origin[3][kPacketSize];
+  /// The x, y, and z components of each ray's direction
+  alignas(32) Real direction[3][kPacketSize];
+  /// 1 / direction for each component of each ray
+  alignas(32) Real inverse_direction[3][kPacketSize];
+  /// The far end of each ray's interval; lowered as closer hits are found
+  alignas(32) Real t_max[kPacketSize];
+  /// A bit mask of the lanes which hold a ray
+  int active = 0;
+
+  /// Construct an empty packet
+  RayPacket();
+
+  /// Put the ray \p r, tested up to \p t_max, into lane \p lane.
+  void set(int lane, const Ray& r, Real t_max);
+
+  /// Return the ray in lane \p lane
+  Ray ray(int lane) const;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _REAL_H_
+#define _REAL_H_
+
+/// Real is the floating point type of the renderer's geometry: the
+/// components of every Vec3, ray parameters and the sphere arrays which the
+/// intersection kernels read. It is double unless the program is built with
+/// RT_FLOAT defined (make PRECISION=float), which makes it float. A float
+/// build moves half as many bytes of sphere data and fits twice as many
+/// lanes into each SIMD register; a double build is the more accurate one.
+/// Scene files, options and random numbers stay in double either way.
+#ifdef RT_FLOAT
+using Real = float;
+#else
+using Real = double;
+#endif
+
+#endif
@@ -0,0 +1,435 @@
+#include "render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "camera.h"
+#include "material.h"
+#include "parallel.h"
+#include "ray_packet.h"
+#include "rng.h"
+#include "utility.h"
+
+// See the header file for documentation.
+
+namespace {
+// A contiguous block of tiles handed to one worker. The owner and any
+// thieves claim tiles from the block with the same atomic counter. The
+// padding keeps neighboring blocks out of each other's cache line.
+struct TileBlock {
+  std::atomic<int> next{0};
+  int end = 0;
+  char padding[64 - sizeof(std::atomic<int>) - sizeof(int)];
+};
+
+// Claim the next tile from block, returns -1 when the block is empty.
+int ClaimTile(TileBlock& block) {
+  if (block.next.load(std::memory_order_relaxed) >= block.end) {
+    return -1;
+  }
+  int tile = block.next.fetch_add(1, std::memory_order_relaxed);
+  return tile < block.end ? tile : -1;
+}
+
+// The color of the sky seen along a ray which strikes nothing.
+Color SkyColor(const Ray& r) {
+  Color sky_top{0.4980392156862745, 0.7450980392156863, 0.9215686274509803};
+  Color sky_bottom{1, 1, 1};
+  Vec3 unit_direction = UnitVector(r.direction());
+  double t = 0.5 * (unit_direction.y() + 1.0);
+  return (1.0 - t) * sky_bottom + t * sky_top;
+}
+
+// Shadow and reflected rays start this far above the surface, relative
+// to the size of the hit point's coordinates, so that rounding in the hit
+// point cannot leave the start of the ray inside the surface it leaves
+// (shadow acne).
+const Real kSurfaceBias = 1024 * std::numeric_limits<Real>::epsilon();
+
+// The offset from the hit rec to the start of a ray which leaves the
+// surface on the side the normal points to.
+Vec3 SurfaceOffset(const HitRecord& rec) {
+  Real scale = std::max({Real(1), std::abs(rec.p.x()), std::abs(rec.p.y()),
+                         std::abs(rec.p.z())});
+  return (kSurfaceBias * scale) * rec.normal;
+}
+
+// The brightest channel of c
+Real Power(const Color& c) { return std::max({c.r(), c.g(), c.b()}); }
+
+// True if something in world blocks light from the hit rec. A surface
+// facing away from the light shadows itself, which needs no shadow ray.
+bool InShadow(const Hittable& world, const HitRecord& rec,
+              const LightSample& light) {
+  if (Dot(light.to_light, rec.normal) <= 0) {
+    return true;
+  }
+  Vec3 offset = SurfaceOffset(rec);
+  // A point light stays at t = 1 along the direction from the new origin.
+  Vec3 direction =
+      std::isinf(light.t_max) ? light.to_light : light.to_light - offset;
+  RenderCounters& counters = ThreadCounters();
+  counters.shadow_rays++;
+  bool occluded = world.occluded(Ray{rec.p + offset, direction}, light.t_max);
+  counters.occlusions += occluded ? 1 : 0;
+  return occluded;
+}
+
+// The color of the hit rec of the ray r, shaded with its material and the
+// lights chosen to shade it.
+Color ShadeHit(const Hittable& world, const LightList& lights,
+               const RenderSettings& settings, const Ray& r,
+               const HitRecord& rec) {
+  thread_local std::vector<LightSample> samples;
+  lights.sample(rec.p, samples);
+  if (settings.shadows) {
+    samples.erase(std::remove_if(samples.begin(), samples.end(),
+                                 [&](const LightSample& light) {
+                                   return InShadow(world, rec, light);
+                                 }),
+                  samples.end());
+  }
+  ThreadCounters().shading_calls++;
+  const SpecularTable* specular_table =
+      settings.exact_specular ? nullptr
+                              : &Materials().specular_table(rec.material_id);
+  return PhongColor(Materials()[rec.material_id], specular_table, r, rec,
+                    samples);
+}
+
+// The color seen along the ray r which struck the hit rec: the hit shaded
+// with its material plus, at a mirror, the color seen in the mirror
+// direction scaled by the reflectance. The reflections are followed in a
+// loop which carries the product of the reflectances so far as the path's
+// throughput. The path ends at the sky, at a surface which is not a
+// mirror, after max_depth reflections, or by Russian roulette: past
+// roulette_depth reflections it survives with a chance equal to its
+// brightest channel of throughput and, if it does, the throughput is
+// divided by that chance so that the average color is unchanged.
+Color ShadePath(const Hittable& world, const LightList& lights,
+                const RenderSettings& settings, Ray r, HitRecord rec) {
+  Color color;
+  Color throughput{1, 1, 1};
+  for (int depth = 0;; depth++) {
+    color += throughput * ShadeHit(world, lights, settings, r, rec);
+    const Color& reflectance = Materials()[rec.material_id].reflectance;
+    if (depth >= settings.max_depth || !(Power(reflectance) > 0)) {
+      break;
+    }
+    throughput *= reflectance;
+    if (depth >= settings.roulette_depth) {
+      Real survival = std::min(Real(1), Power(throughput));
+      if (RandomDouble01() >= survival) {
+        break;
+      }
+      throughput *= Real(1) / survival;
+    }
+    r = Ray{rec.p + SurfaceOffset(rec), Reflect(-r.direction(), rec.normal)};
+    RenderCounters& counters = ThreadCounters();
+    counters.reflection_rays++;
+    if (!world.hit(r, 0.0, kInfinity, rec)) {
+      color += throughput * SkyColor(r);
+      break;
+    }
+    counters.hits++;
+  }
+  return color;
+}
+
+// White where the ray strikes something, black where it sees the sky. This
+// is what Render() traces when shading is turned off.
+Color Coverage(const Ray& r, const Hittable& world) {
+  HitRecord rec;
+  if (world.hit(r, 0.0, kInfinity, rec)) {
+    ThreadCounters().hits++;
+    return Color{1, 1, 1};
+  }
+  return Color{};
+}
+
+// The running totals of one pixel's samples.
+struct PixelState {
+  Color sum;
+  double luminance_squares = 0.0;
+  int samples = 0;
+  bool converged = false;
+};
+
+double Luminance(const Color& c) {
+  return 0.2126 * c.r() + 0.7152 * c.g() + 0.0722 * c.b();
+}
+
+// True once the standard error of the pixel's mean luminance is within the
+// noise threshold.
+bool Converged(const PixelState& pixel, double noise_threshold) {
+  const double kDarkestMean = 0.05;
+  double n = pixel.samples;
+  double mean = Luminance(pixel.sum) / n;
+  double variance =
+      std::max(0.0, (pixel.luminance_squares - n * mean * mean) / (n - 1.0));
+  double standard_error = std::sqrt(variance / n);
+  return standard_error <= noise_threshold * std::max(mean, kDarkestMean);
+}
+
+// Add the sample c to the pixel's totals and, with adaptive sampling,
+// check whether the pixel has converged.
+void AddSample(const RenderSettings& settings, const Color& c,
+               PixelState& pixel) {
+  pixel.sum += c;
+  pixel.samples++;
+  if (settings.noise_threshold > 0.0) {
+    double luminance = Luminance(c);
+    pixel.luminance_squares += luminance * luminance;
+    int min_samples = std::max(2, settings.min_samples_per_pixel);
+    if (pixel.samples >= min_samples &&
+        Converged(pixel, settings.noise_threshold)) {
+      pixel.converged = true;
+    }
+  }
+}
+
+// The number of bits set in mask, the lanes of a packet it selects.
+int Popcount(int mask) { return __builtin_popcount(unsigned(mask)); }
+
+// The camera ray through a random point of the pixel at column, row.
+Ray CameraRay(const Camera& camera, int column, int row) {
+  double u = RandomDouble01();
+  double v = RandomDouble01();
+  return camera.ray(double(column) + u, double(row) + v);
+}
+
+// Take samples through the pixel at column, row until it has target
+// samples or, with adaptive sampling, it has converged.
+void SamplePixel(const Hittable& world, const RenderSettings& settings,
+                 const Camera& camera, const LightList& lights, int column,
+                 int row, int target, PixelState& pixel) {
+  while (pixel.samples < target && !pixel.converged) {
+    ThreadCounters().camera_rays++;
+    Ray r = CameraRay(camera, column, row);
+    Color c = settings.shade ? RayColor(r, world, lights, settings)
+                             : Coverage(r, world);
+    AddSample(settings, c, pixel);
+  }
+}
+
+// Take samples through up to kPacketSize neighboring pixels at once, one
+// pixel per lane of a RayPacket, until each has target samples or has
+// converged. A pixel which is done leaves its lane empty.
+void SamplePacket(const Hittable& world, const RenderSettings& settings,
+                  const Camera& camera, const LightList& lights,
+                  const int* columns, const int* rows, int lanes, int target,
+                  PixelState* const* pixels) {
+  while (true) {
+    RayPacket packet;
+    for (int lane = 0; lane < lanes; lane++) {
+      const PixelState& pixel = *pixels[lane];
+      if (pixel.samples < target && !pixel.converged) {
+        Ray r = CameraRay(camera, columns[lane], rows[lane]);
+        packet.set(lane, r, kInfinity);
+      }
+    }
+    if (packet.active == 0) {
+      return;
+    }
+    HitRecord recs[kPacketSize];
+    int hits = world.hit_packet(packet, 0.0, recs);
+    RenderCounters& counters = ThreadCounters();
+    counters.camera_rays += Popcount(packet.active);
+    counters.hits += Popcount(hits);
+    for (int lane = 0; lane < lanes; lane++) {
+      if ((packet.active & (1 << lane)) == 0) {
+        continue;
+      }
+      bool hit = (hits & (1 << lane)) != 0;
+      Ray r = packet.ray(lane);
+      Color c;
+      if (!settings.shade) {
+        c = hit ? Color{1, 1, 1} : Color{};
+      } else {
+        c = hit ? ShadePath(world, lights, settings, r, recs[lane])
+                : SkyColor(r);
+      }
+      AddSample(settings, c, *pixels[lane]);
+    }
+  }
+}
+
+// Render one pass over the pixels of one tile. With a single pass the
+// pixels go straight into the framebuffer, otherwise their running totals
+// are kept in pixels between passes. Returns the samples taken.
+long long RenderTile(const Hittable& world, const RenderSettings& settings,
+                     const Camera& camera, const LightList& lights, int tile,
+                     int tiles_across, int pass,
+                     std::vector<PixelState>& pixels,
+                     std::vector<Color>& framebuffer) {
+  SeedRandom(MixSeed(MixSeed(settings.seed, std::uint64_t(tile)),
+                     std::uint64_t(pass)));
+  // Each pass brings every pixel up to its share of the samples.
+  int target = int((long long)settings.samples_per_pixel * (pass + 1) /
+                   settings.passes);
+  // Tiles are laid out from the top of the image down, like the
+  // framebuffer, while rows are counted from the bottom of the image up.
+  int top = (tile / tiles_across) * settings.tile_size;
+  int left = (tile % tiles_across) * settings.tile_size;
+  int bottom = std::min(top + settings.tile_size, settings.height);
+  int right = std::min(left + settings.tile_size, settings.width);
+  // With packets the tile is walked in 2x2 groups of pixels which are
+  // sampled together; otherwise one pixel at a time.
+  int step = settings.packets ? 2 : 1;
+  // The last pass records how many samples each pixel ended up with.
+  bool last_pass = pass + 1 == settings.passes;
+  long long samples = 0;
+  for (int y = top; y < bottom; y += step) {
+    for (int x = left; x < right; x += step) {
+      int columns[kPacketSize];
+      int rows[kPacketSize];
+      std::size_t indices[kPacketSize];
+      PixelState locals[kPacketSize];
+      PixelState* group[kPacketSize];
+      int before = 0;
+      int lanes = 0;
+      for (int dy = 0; dy < step && y + dy < bottom; dy++) {
+        for (int dx = 0; dx < step && x + dx < right; dx++) {
+          std::size_t index =
+              std::size_t(y + dy) * std::size_t(settings.width) +
+              std::size_t(x + dx);
+          PixelState* pixel = pixels.empty() ? &locals[lanes] : &pixels[index];
+          if (pixel->converged) {
+            if (last_pass) {
+              ThreadCounters().add_pixel(pixel->samples);
+            }
+            continue;
+          }
+          columns[lanes] = x + dx;
+          rows[lanes] = settings.height - 1 - (y + dy);
+          indices[lanes] = index;
+          group[lanes] = pixel;
+          before += pixel->samples;
+          lanes++;
+        }
+      }
+      if (lanes == 0) {
+        continue;
+      }
+      if (settings.packets) {
+        SamplePacket(world, settings, camera, lights, columns, rows, lanes,
+                     target, group);
+      } else {
+        SamplePixel(world, settings, camera, lights, columns[0], rows[0],
+                    target, *group[0]);
+      }
+      for (int lane = 0; lane < lanes; lane++) {
+        samples += group[lane]->samples;
+        if (last_pass) {
+          ThreadCounters().add_pixel(group[lane]->samples);
+        }
+        if (pixels.empty()) {
+          framebuffer[indices[lane]] =
+              (1.0 / double(group[lane]->samples)) * group[lane]->sum;
+        }
+      }
+      samples -= before;
+    }
+  }
+  return samples;
+}
+
+// Call render_tile(tile) for every tile on a pool of num_threads threads.
+// Each thread drains its own block of tiles first and then steals from
+// the other blocks.
+void ForEachTile(int num_tiles, int num_threads,
+                 const std::function<void(int tile)>& render_tile) {
+  // Deal the tiles out in contiguous blocks, one block per worker.
+  std::vector<TileBlock> blocks(num_threads);
+  for (int i = 0; i < num_threads; i++) {
+    blocks[i].next = num_tiles * i / num_threads;
+    blocks[i].end = num_tiles * (i + 1) / num_threads;
+  }
+  auto worker = [&](int id) {
+    for (int i = 0; i < num_threads; i++) {
+      TileBlock& block = blocks[(id + i) % num_threads];
+      for (int tile = ClaimTile(block); tile >= 0; tile = ClaimTile(block)) {
+        render_tile(tile);
+      }
+    }
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(num_threads - 1);
+  for (int id = 1; id < num_threads; id++) {
+    pool.emplace_back(worker, id);
+  }
+  // The calling thread is a worker too.
+  worker(0);
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+}  // namespace
+
+Color RayColor(const Ray& r, const Hittable& world, const LightList& lights,
+               const RenderSettings& settings) {
+  HitRecord rec;
+  double t_min = 0.0;
+  if (world.hit(r, t_min, kInfinity, rec)) {
+    ThreadCounters().hits++;
+    return ShadePath(world, lights, settings, r, rec);
+  }
+  return SkyColor(r);
+}
+
+std::vector<Color> Render(const Hittable& world,
+                          const RenderSettings& settings,
+                          RenderStats* stats) {
+  std::size_t num_pixels =
+      std::size_t(settings.width) * std::size_t(settings.height);
+  std::vector<Color> framebuffer(num_pixels);
+  Camera camera{settings.camera, settings.width, settings.height};
+  LightList lights{settings.lights, settings.light_cutoff,
+                   settings.light_samples};
+  int tiles_across = (settings.width + settings.tile_size - 1) /
+                     settings.tile_size;
+  int tiles_down = (settings.height + settings.tile_size - 1) /
+                   settings.tile_size;
+  int num_tiles = tiles_across * tiles_down;
+
+  int num_threads = std::min(ThreadCount(settings.threads), num_tiles);
+
+  // Progressive rendering keeps every pixel's running totals between
+  // passes; a single pass needs no more than the framebuffer.
+  int passes = std::max(1, std::min(settings.passes,
+                                    settings.samples_per_pixel));
+  RenderSettings pass_settings = settings;
+  pass_settings.passes = passes;
+  std::vector<PixelState> pixels(passes > 1 ? num_pixels : 0);
+  std::atomic<long long> samples{0};
+  // Each thread counts into its own counters, which are emptied before a
+  // tile and added to the totals after it.
+  RenderCounters counters;
+  std::mutex counters_mutex;
+  for (int pass = 0; pass < passes; pass++) {
+    ForEachTile(num_tiles, num_threads, [&](int tile) {
+      ThreadCounters() = RenderCounters{};
+      samples += RenderTile(world, pass_settings, camera, lights, tile,
+                            tiles_across, pass, pixels, framebuffer);
+      std::lock_guard<std::mutex> lock(counters_mutex);
+      counters += ThreadCounters();
+    });
+    if (passes > 1) {
+      for (std::size_t i = 0; i < num_pixels; i++) {
+        framebuffer[i] = (1.0 / double(pixels[i].samples)) * pixels[i].sum;
+      }
+    }
+    if (settings.on_pass) {
+      settings.on_pass(pass + 1, framebuffer);
+    }
+  }
+  if (stats != nullptr) {
+    stats->samples = samples;
+    stats->counters = counters;
+  }
+  return framebuffer;
+}
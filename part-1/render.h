@@ -0,0 +1,115 @@
+#ifndef _RENDER_H_
+#define _RENDER_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "camera.h"
+#include "hittable.h"
+#include "light.h"
+#include "ray.h"
+#include "stats.h"
+#include "vec3.h"
+
+/// The settings which control how an image is rendered.
+struct RenderSettings {
+  /// The width of the image in pixels
+  int width = 800;
+  /// The height of the image in pixels
+  int height = 450;
+  /// Where the camera is, where it looks and its field of view
+  CameraView camera;
+  /// The largest number of rays traced through each pixel. Unless adaptive
+  /// sampling is on, every pixel gets exactly this many.
+  int samples_per_pixel = 50;
+  /// With adaptive sampling, the number of rays every pixel gets before it
+  /// is checked for convergence
+  int min_samples_per_pixel = 8;
+  /// The noise threshold for adaptive sampling, 0 turns it off. A pixel
+  /// stops taking samples once the standard error of its mean luminance is
+  /// at most this fraction of the mean (or of 0.05 for very dark pixels).
+  double noise_threshold = 0.0;
+  /// The number of passes over the whole image. Each pass takes an equal
+  /// share of samples_per_pixel, so the image is refined progressively.
+  int passes = 1;
+  /// Called with the pass number (counting from 1) and the image so far at
+  /// the end of each pass; may be empty.
+  std::function<void(int pass, const std::vector<Color>& framebuffer)>
+      on_pass;
+  /// The number of rendering threads; 0 means one per hardware thread
+  int threads = 0;
+  /// The width and height of the square tiles the image is divided into
+  int tile_size = 16;
+  /// The seed from which every tile's random numbers are derived
+  std::uint64_t seed = 0;
+  /// When false, rays are only intersected with the world and the image
+  /// shows which pixels are covered. Benchmarks use this to separate the
+  /// time spent finding hits from the time spent shading them.
+  bool shade = true;
+  /// The lights of the scene
+  std::vector<Light> lights = DefaultLights();
+  /// A light is not used to shade a point where its brightest channel is
+  /// below this; 0 uses every light everywhere
+  double light_cutoff = 1e-3;
+  /// The largest number of lights used to shade a point. When more lights
+  /// reach it, this many are chosen at random; 0 uses every light.
+  int light_samples = 8;
+  /// When true, a shadow ray is traced from every hit toward each light
+  /// shading it, and lights which are blocked do not light the hit.
+  bool shadows = true;
+  /// The largest number of mirror reflections followed from a camera ray;
+  /// 0 shades only the first surface struck
+  int max_depth = 8;
+  /// The first roulette_depth reflections of a path are always followed.
+  /// Past them a path goes on with a chance equal to its brightest channel
+  /// of throughput (Russian roulette), so dim paths end early.
+  int roulette_depth = 2;
+  /// When true, the specular highlight is computed with std::pow() rather
+  /// than looked up in the material's SpecularTable. This is slower and
+  /// only serves to measure the error of the tables.
+  bool exact_specular = false;
+  /// When true, camera rays through each 2x2 group of pixels are traced
+  /// together as a RayPacket. The rays are nearly parallel so they visit
+  /// the same BVH nodes and each node is tested once for all four of them.
+  bool packets = true;
+};
+
+/// Return the color seen along the ray \p r.
+/// The closest object in \p world struck by the ray is shaded with its
+/// material. Rays which miss everything see the sky. A mirror adds the
+/// color seen in the mirror direction, scaled by its reflectance; the
+/// reflections are followed in a loop rather than by recursion, up to
+/// settings.max_depth of them.
+/// \param r The ray to trace
+/// \param world The scene, usually a BVH built over the scene's objects
+/// \param lights The lights of the scene
+/// \param settings Whether to trace shadow rays and how many reflections
+/// to follow
+/// \returns The color seen along the ray
+Color RayColor(const Ray& r, const Hittable& world, const LightList& lights,
+               const RenderSettings& settings);
+
+/// Render \p world into a framebuffer.
+/// The image is divided into square tiles which are shared out among a pool
+/// of threads. Each thread starts with its own contiguous block of tiles
+/// and, once that runs dry, steals tiles from the other threads' blocks.
+/// Every tile draws its random numbers from a sequence derived from the
+/// seed, the tile's position and the pass, so the image is identical no
+/// matter how many threads render it.
+///
+/// With adaptive sampling a pixel stops taking samples as soon as it has
+/// converged. Pixels which only see the smooth sky or the middle of a
+/// sphere converge after min_samples_per_pixel samples, leaving the full
+/// budget to the edges where it is needed.
+/// \param world The scene, usually a BVH built over the scene's objects
+/// \param settings The image size, sampling, threads and seed
+/// \param stats If not null, filled in with figures about the render
+/// \returns The linear pixel colors (the average of each pixel's samples)
+/// ordered from the upper left corner to the lower right corner of the
+/// image, ready to be handed to Image::write_framebuffer().
+std::vector<Color> Render(const Hittable& world,
+                          const RenderSettings& settings,
+                          RenderStats* stats = nullptr);
+
+#endif
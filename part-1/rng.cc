@@ -1,19 +1,40 @@
-
 #include "rng.h"
 
 // See the header file for documentation
 
-// Secret global variable that is used by random_double_01()
-static RandomNumberGenerator rng01{0, 1};
+namespace {
+// Secret per-thread engine used by all of the RandomDouble functions. The
+// engine is constant initialized so using it costs no more than a global.
+thread_local RandomEngine engine;
+}  // namespace
+
+void Xoshiro256::seed(std::uint64_t seed) {
+  // SplitMix64 never yields four zero words in a row so the state is valid.
+  for (auto& word : state_) {
+    seed += 0x9E3779B97F4A7C15ULL;
+    std::uint64_t z = seed;
+    z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+    word = z ^ (z >> 31U);
+  }
+}
+
+RandomEngine& ThreadRandomEngine() { return engine; }
+
+void SeedRandom(std::uint64_t seed) { engine.seed(seed); }
 
-// Secret global variable that is used by random_double_11()
-static RandomNumberGenerator rng11{-1, 1};
+std::uint64_t MixSeed(std::uint64_t seed, std::uint64_t stream) {
+  // SplitMix64 finalizer applied to the seed offset by the stream index.
+  std::uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30U)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27U)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31U);
+}
 
 double RandomDouble(double min, double max) {
-  RandomNumberGenerator rng(min, max);
-  return rng.next();
+  return min + (max - min) * engine.next_double();
 }
 
-double RandomDouble01() { return rng01.next(); }
+double RandomDouble01() { return engine.next_double(); }
 
-double RandomDouble11() { return rng11.next(); }
+double RandomDouble11() { return RandomDouble(-1, 1); }
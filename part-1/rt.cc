@@ -9,62 +9,47 @@
 // The program creates a ray tracer and outputs many spheres with more samples.
 //
 
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <future>
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <random>
 #include <sstream>
 #include <string>
 
+#include "bvh.h"
+#include "grid.h"
 #include "image.h"
+#include "options.h"
+#include "random_scene.h"
 #include "ray.h"
+#include "render.h"
+#include "rng.h"
+#include "scene.h"
 #include "sphere.h"
+#include "stats.h"
 #include "utility.h"
 #include "vec3.h"
 
 using namespace std;
 
-Color RayColor(const Ray &r, const std::vector<std::shared_ptr<Hittable>> &world) {
-  HitRecord rec;
-  Color c;
-  HitRecord tmp_rec;
-  bool hit_anything = false;
-  double t_min = 0.0;
-  double closest_so_far = kInfinity;
-  for (const auto &object : world) {
-    if (object->hit(r, t_min, closest_so_far, tmp_rec)) {
-      hit_anything = true;
-      closest_so_far = tmp_rec.t;
-      rec = tmp_rec;
-    }
-  }
-  if (hit_anything) {
-    c = rec.material->reflect_color(r, rec);
-  } else {
-    Color sky_top{0.4980392156862745, 0.7450980392156863, 0.9215686274509803};
-    Color sky_bottom{1, 1, 1};
-    Vec3 unit_direction = UnitVector(r.direction());
-    double t = 0.5 * (unit_direction.y() + 1.0);
-    c = (1.0 - t) * sky_bottom + t * sky_top;
-  }
-  return c;
-}
 void ErrorMessage(const string &message) {
   cout << message << "\n";
   cout << "There was an error. Exiting.\n";
 }
 int main(int argc, char const *argv[]) {
-  if (argc < 2) {
-    ErrorMessage("Please provide a path to a file.");
+  Options options;
+  string error;
+  if (!ParseOptions(argc, argv, options, error)) {
+    ErrorMessage(error + "\n" + Usage(argv[0]));
     exit(1);
   }
-  string argv_one_output_file_name = string(argv[1]);
-  const double kAspectRatio = 16.0 / 9.0;
-  const int kImageWidth = 800;
-  const int kImageHeight = int(lround(kImageWidth / kAspectRatio));
-  const int kSamplesPerPixel = 50;
-  Image image(argv_one_output_file_name, kImageWidth, kImageHeight);
+  string argv_one_output_file_name = options.output_file_name;
+  Image image(argv_one_output_file_name, options.width, ImageHeight(options),
+              options.format);
   if (!image.is_open()) {
     ostringstream message_buffer("Could not open the file ", ios_base::ate);
     message_buffer << argv_one_output_file_name << "!";
@@ -72,40 +57,149 @@ int main(int argc, char const *argv[]) {
     exit(1);
   }
   cout << "Image: " << image.height() << "x" << image.width() << "\n";
-  const int kNumSpheres = 100;
-  auto world = RandomScene(kNumSpheres);
-  const double kViewportHeight = 2.0;
-  const double kViewportWidth = kAspectRatio * kViewportHeight;
-  const double kFocalLength = 1.0;
-  const Point3 kOrigin{0, 0, 0};
-  const Vec3 kHorizontal{kViewportWidth, 0, 0};
-  const Vec3 kVertical{0, kViewportHeight, 0};
-  const Vec3 kLowerLeftCorner =
-      kOrigin - kHorizontal / 2 - kVertical / 2 - Vec3(0, 0, kFocalLength);
-  chrono::time_point<chrono::high_resolution_clock> start =
+  if (!options.has_seed) {
+    random_device rd;
+    options.seed = (uint64_t(rd()) << 32U) | rd();
+  }
+  cout << "Seed: " << options.seed << "\n";
+  SeedRandom(options.seed);
+  chrono::time_point<chrono::high_resolution_clock> load_start =
       chrono::high_resolution_clock::now();
-  Color pixel_color;
-  for (int row = image.height() - 1; row >= 0; row--) {
-    for (int column = 0; column < image.width(); column++) {
-      for (int s = 0; s < kSamplesPerPixel; s++) {
-        double u = (double(column) + RandomDouble01()) / double(image.width() - 1);
-        double v = (double(row) + RandomDouble01()) / double(image.height() - 1);
-        Ray r{kOrigin,
-              kLowerLeftCorner + u * kHorizontal + v * kVertical - kOrigin};
-        pixel_color = pixel_color + RayColor(r, world);
-      }
-      double scale = 1.0 / double(kSamplesPerPixel);
-      double r = Clamp(std::sqrt(pixel_color.r() * scale), 0.0, 1.0);
-      double g = Clamp(std::sqrt(pixel_color.g() * scale), 0.0, 1.0);
-      double b = Clamp(std::sqrt(pixel_color.b() * scale), 0.0, 1.0);
-      pixel_color = Color(r, g, b);
-      image.write(pixel_color);
+  Scene scene;
+  if (!options.scene_file_name.empty()) {
+    if (!LoadScene(options.scene_file_name, scene, error)) {
+      ErrorMessage(error);
+      exit(1);
     }
+  } else {
+    RandomSceneSettings random;
+    random.num_spheres = options.num_spheres;
+    random.seed = options.seed;
+    random.threads = options.threads;
+    random.min_radius = options.min_radius;
+    random.max_radius = options.max_radius;
+    random.density = options.density;
+    random.no_overlap = options.no_overlap;
+    int placed = GenerateRandomScene(random, scene);
+    if (placed < random.num_spheres) {
+      cout << "Only " << placed << " of " << random.num_spheres
+           << " spheres fit without overlapping.\n";
+    }
+  }
+  chrono::time_point<chrono::high_resolution_clock> load_end =
+      chrono::high_resolution_clock::now();
+  chrono::duration<double> load_seconds = load_end - load_start;
+  cout << "Scene: " << scene.spheres.size() << " spheres loaded in "
+       << load_seconds.count() << " seconds.\n";
+  CameraView view = CameraFromOptions(options, scene.camera);
+  if (!CheckCameraView(view, error)) {
+    ErrorMessage("The camera cannot be set up: " + error + ".");
+    exit(1);
   }
+  // The scene files are written on threads of their own while the BVH is
+  // built and the image rendered; nothing changes the scene in the meantime.
+  string save_scene_error;
+  string save_cache_error;
+  future<bool> saved_scene;
+  future<bool> saved_cache;
+  if (!options.save_scene_file_name.empty()) {
+    saved_scene = async(launch::async, [&]() {
+      return SaveSceneText(options.save_scene_file_name, scene,
+                           save_scene_error);
+    });
+  }
+  if (!options.save_cache_file_name.empty()) {
+    saved_cache = async(launch::async, [&]() {
+      return SaveSceneBinary(options.save_cache_file_name, scene,
+                             save_cache_error);
+    });
+  }
+  chrono::time_point<chrono::high_resolution_clock> build_start =
+      chrono::high_resolution_clock::now();
+  unique_ptr<Hittable> world;
+  ostringstream built;
+  if (options.acceleration == Acceleration::kGrid) {
+    auto grid = make_unique<Grid>(scene.spheres, options.threads);
+    array<int, 3> resolution = grid->resolution();
+    built << "Grid of " << resolution[0] << "x" << resolution[1] << "x"
+          << resolution[2] << " cells";
+    world = move(grid);
+  } else if (options.acceleration == Acceleration::kLinearBVH) {
+    world = make_unique<BVH>(scene.spheres, BVH::Builder::kLinear,
+                             options.threads);
+    built << "Linear BVH";
+  } else {
+    world = make_unique<BVH>(scene.spheres);
+    built << "BVH";
+  }
+  chrono::duration<double> build_seconds =
+      chrono::high_resolution_clock::now() - build_start;
+  cout << built.str() << " built in " << build_seconds.count()
+       << " seconds.\n";
+  RenderSettings settings;
+  settings.width = image.width();
+  settings.height = image.height();
+  settings.camera = view;
+  settings.samples_per_pixel = options.samples_per_pixel;
+  settings.min_samples_per_pixel = options.min_samples_per_pixel;
+  settings.noise_threshold = options.noise_threshold;
+  settings.passes = options.passes;
+  settings.shadows = options.shadows;
+  settings.light_cutoff = options.light_cutoff;
+  settings.light_samples = options.light_samples;
+  settings.max_depth = options.max_depth;
+  settings.roulette_depth = options.roulette_depth;
+  if (!scene.lights.empty()) {
+    settings.lights = scene.lights;
+  }
+  settings.threads = options.threads;
+  settings.seed = options.seed;
+  if (settings.passes > 1) {
+    // Rewrite the image after every pass so the render can be previewed.
+    settings.on_pass = [&](int pass, const vector<Color> &framebuffer) {
+      image.write_framebuffer(framebuffer);
+      image.write_preview();
+      cout << "Pass " << pass << " of " << settings.passes << " done.\n";
+    };
+  }
+  chrono::time_point<chrono::high_resolution_clock> start =
+      chrono::high_resolution_clock::now();
+  FrameStats stats;
+  vector<Color> framebuffer = Render(*world, settings, &stats.render);
+  chrono::time_point<chrono::high_resolution_clock> render_end =
+      chrono::high_resolution_clock::now();
+  image.write_framebuffer(framebuffer);
+  image.close();
   chrono::time_point<chrono::high_resolution_clock> end =
       chrono::high_resolution_clock::now();
   chrono::duration<double> elapsed_seconds = end - start;
+  cout << "Samples: " << stats.render.samples << " ("
+       << double(stats.render.samples) / (image.width() * image.height())
+       << " per pixel)\n";
   cout << "Time elapsed: " << elapsed_seconds.count() << " seconds.\n";
+  stats.width = image.width();
+  stats.height = image.height();
+  stats.spheres = scene.spheres.size();
+  stats.scene_seconds = load_seconds.count();
+  stats.acceleration_seconds = build_seconds.count();
+  stats.render_seconds =
+      chrono::duration<double>(render_end - start).count();
+  stats.output_seconds = chrono::duration<double>(end - render_end).count();
+  if (saved_scene.valid() && !saved_scene.get()) {
+    ErrorMessage(save_scene_error);
+    exit(1);
+  }
+  if (saved_cache.valid() && !saved_cache.get()) {
+    ErrorMessage(save_cache_error);
+    exit(1);
+  }
+  if (options.print_stats) {
+    PrintStats(cout, stats);
+  }
+  if (!options.stats_file_name.empty() &&
+      !WriteStatsJson(options.stats_file_name, stats, error)) {
+    ErrorMessage(error);
+    exit(1);
+  }
   return 0;
 }
-    
\ No newline at end of file
@@ -0,0 +1,562 @@
+#include "scene.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "sphere.h"
+
+// See the header file for documentation.
+
+namespace {
+// The first bytes of every binary scene file.
+const char kBinaryMagic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', 'B'};
+const std::uint32_t kBinaryVersion = 2;
+// Written as is; a file from a machine with the other byte order reads
+// back as 0x04030201 and is rejected.
+const std::uint32_t kByteOrderMark = 0x01020304;
+
+// The binary file is these records one after the other: the header, the
+// camera, the materials, the lights, the sphere arrays (x, y, z, radius,
+// then material index, padded to a multiple of 8 bytes) and finally the
+// material names. Every record is a multiple of 8 bytes long so that the
+// arrays in a mapped file are suitably aligned.
+struct BinaryHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t num_materials;
+  std::uint64_t num_spheres;
+  std::uint64_t num_lights;
+  std::uint64_t names_size;
+  std::uint32_t has_camera;
+  std::uint32_t reserved;
+};
+
+struct BinaryCamera {
+  double position[3];
+  double look_at[3];
+  double up[3];
+  double vertical_fov;
+};
+
+struct BinaryMaterial {
+  double ambient[3];
+  double diffuse[3];
+  double specular[3];
+  double shininess;
+  double reflectance[3];
+  std::uint64_t name_offset;
+  std::uint64_t name_size;
+};
+
+struct BinaryLight {
+  std::uint32_t type;
+  std::uint32_t reserved;
+  double vector[3];
+  double color[3];
+};
+
+// The size of the material index array rounded up to a multiple of 8.
+std::uint64_t IndexBytes(std::uint64_t num_spheres) {
+  return (num_spheres * sizeof(std::int32_t) + 7) / 8 * 8;
+}
+
+// A read only memory mapping of a whole file, unmapped when destroyed.
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& file_name) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void* data =
+          mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd,
+               0);
+      if (data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        size_ = std::size_t(info.st_size);
+      }
+    }
+    close(fd);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+Vec3 ToVec3(const double* v) { return Vec3{v[0], v[1], v[2]}; }
+
+void FromVec3(const Vec3& v, double* out) {
+  out[0] = v.x();
+  out[1] = v.y();
+  out[2] = v.z();
+}
+
+// The IDs of the materials the scene's spheres use, in the order they are
+// first used. file_index maps each ID to its position in the returned list
+// (and is -1 for materials the scene does not use).
+std::vector<int> UsedMaterials(const Scene& scene,
+                               std::vector<int>& file_index) {
+  std::vector<int> used;
+  file_index.assign(Materials().size(), -1);
+  for (int i = 0; i < scene.spheres.size(); i++) {
+    int id = scene.spheres.material_id(i);
+    if (file_index[id] < 0) {
+      file_index[id] = int(used.size());
+      used.push_back(id);
+    }
+  }
+  return used;
+}
+
+bool LoadSceneBinary(const std::string& file_name, Scene& scene,
+                     std::string& error) {
+  MappedFile file(file_name);
+  if (file.data() == nullptr) {
+    error = "Could not map the scene file " + file_name + ".";
+    return false;
+  }
+  error = file_name + " is not a valid binary scene file.";
+  BinaryHeader header;
+  if (file.size() < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, kBinaryMagic, sizeof(kBinaryMagic)) != 0 ||
+      header.version != kBinaryVersion ||
+      header.byte_order != kByteOrderMark ||
+      header.num_spheres > std::uint64_t(std::numeric_limits<int>::max()) ||
+      header.num_materials > file.size() || header.num_lights > file.size() ||
+      header.names_size > file.size()) {
+    return false;
+  }
+  std::uint64_t n = header.num_spheres;
+  std::uint64_t expected =
+      sizeof(BinaryHeader) + sizeof(BinaryCamera) +
+      header.num_materials * sizeof(BinaryMaterial) +
+      header.num_lights * sizeof(BinaryLight) + 4 * n * sizeof(double) +
+      IndexBytes(n) + header.names_size;
+  if (file.size() < expected) {
+    return false;
+  }
+
+  const char* cursor = file.data() + sizeof(BinaryHeader);
+  BinaryCamera camera;
+  std::memcpy(&camera, cursor, sizeof(camera));
+  cursor += sizeof(camera);
+  scene.has_camera = header.has_camera != 0;
+  scene.camera.position = ToVec3(camera.position);
+  scene.camera.look_at = ToVec3(camera.look_at);
+  scene.camera.up = ToVec3(camera.up);
+  scene.camera.vertical_fov = camera.vertical_fov;
+
+  const char* names = file.data() + expected - header.names_size;
+  // The file numbers its materials from 0; ids holds their Materials() IDs.
+  std::vector<int> ids;
+  for (std::uint64_t i = 0; i < header.num_materials; i++) {
+    BinaryMaterial m;
+    std::memcpy(&m, cursor, sizeof(m));
+    cursor += sizeof(m);
+    if (m.name_offset > header.names_size ||
+        m.name_size > header.names_size - m.name_offset) {
+      return false;
+    }
+    ids.push_back(Materials().add(
+        PhongParameters{ToVec3(m.ambient), ToVec3(m.diffuse),
+                        ToVec3(m.specular), m.shininess,
+                        ToVec3(m.reflectance)},
+        std::string(names + m.name_offset, m.name_size)));
+  }
+
+  scene.lights.clear();
+  for (std::uint64_t i = 0; i < header.num_lights; i++) {
+    BinaryLight l;
+    std::memcpy(&l, cursor, sizeof(l));
+    cursor += sizeof(l);
+    if (l.type > 1) {
+      return false;
+    }
+    scene.lights.push_back(Light{l.type == 0 ? Light::Type::kPoint
+                                             : Light::Type::kDirectional,
+                                 ToVec3(l.vector), ToVec3(l.color)});
+  }
+
+  // The sphere arrays are copied straight out of the mapping; only the
+  // material numbers are translated.
+  const double* x = reinterpret_cast<const double*>(cursor);
+  const double* y = x + n;
+  const double* z = y + n;
+  const double* radius = z + n;
+  const std::int32_t* material_index =
+      reinterpret_cast<const std::int32_t*>(radius + n);
+  std::vector<int> material_id(n);
+  for (std::uint64_t i = 0; i < n; i++) {
+    if (material_index[i] < 0 ||
+        std::uint64_t(material_index[i]) >= header.num_materials) {
+      return false;
+    }
+    material_id[i] = ids[material_index[i]];
+  }
+  scene.spheres.assign(int(n), x, y, z, radius, material_id.data());
+  error.clear();
+  return true;
+}
+
+// Read a name, which is quoted if it has spaces in it.
+bool ReadName(std::istream& in, std::string& name) {
+  return bool(in >> std::quoted(name));
+}
+
+bool ReadVec3(std::istream& in, Vec3& v) {
+  double x = 0;
+  double y = 0;
+  double z = 0;
+  if (!(in >> x >> y >> z)) {
+    return false;
+  }
+  v = Vec3{x, y, z};
+  return true;
+}
+
+// Parse one line of a text scene file; returns false with a message in
+// error if the line is not understood.
+bool ParseLine(const std::string& line, Scene& scene,
+               std::map<std::string, int>& material_ids,
+               std::vector<double> arrays[4], std::vector<int>& material_id,
+               std::string& error) {
+  std::istringstream words(line);
+  std::string directive;
+  if (!(words >> directive) || directive[0] == '#') {
+    return true;
+  }
+  if (directive == "material") {
+    std::string name;
+    Color ambient;
+    Color diffuse;
+    Color specular;
+    double shininess = 0;
+    if (!ReadName(words, name) || !ReadVec3(words, ambient) ||
+        !ReadVec3(words, diffuse) || !ReadVec3(words, specular) ||
+        !(words >> shininess)) {
+      error = "a material needs a name, three colors and a shininess";
+      return false;
+    }
+    // The reflectance is optional; without one the material is no mirror.
+    Color reflectance;
+    if (!(words >> std::ws).eof() && !ReadVec3(words, reflectance)) {
+      error = "a material's reflectance needs three numbers";
+      return false;
+    }
+    if (material_ids.count(name) != 0) {
+      error = "the material \"" + name + "\" is defined twice";
+      return false;
+    }
+    material_ids[name] = Materials().add(
+        PhongParameters{ambient, diffuse, specular, shininess, reflectance},
+        name);
+  } else if (directive == "sphere") {
+    Point3 center;
+    double radius = 0;
+    std::string name;
+    if (!ReadVec3(words, center) || !(words >> radius) ||
+        !ReadName(words, name)) {
+      error = "a sphere needs a center, a radius and a material";
+      return false;
+    }
+    if (!(radius > 0)) {
+      error = "a sphere's radius must be positive";
+      return false;
+    }
+    auto found = material_ids.find(name);
+    if (found == material_ids.end()) {
+      error = "the material \"" + name + "\" is not defined";
+      return false;
+    }
+    arrays[0].push_back(center.x());
+    arrays[1].push_back(center.y());
+    arrays[2].push_back(center.z());
+    arrays[3].push_back(radius);
+    material_id.push_back(found->second);
+  } else if (directive == "camera") {
+    CameraView camera;
+    if (!ReadVec3(words, camera.position) ||
+        !ReadVec3(words, camera.look_at) || !ReadVec3(words, camera.up) ||
+        !(words >> camera.vertical_fov)) {
+      error =
+          "a camera needs a position, a point to look at, an up direction"
+          " and a field of view";
+      return false;
+    }
+    if (!CheckCameraView(camera, error)) {
+      return false;
+    }
+    scene.camera = camera;
+    scene.has_camera = true;
+  } else if (directive == "light") {
+    std::string type;
+    Light light;
+    words >> type;
+    if (type == "point") {
+      light.type = Light::Type::kPoint;
+    } else if (type == "directional") {
+      light.type = Light::Type::kDirectional;
+    } else {
+      error = "a light is either point or directional";
+      return false;
+    }
+    if (!ReadVec3(words, light.vector) || !ReadVec3(words, light.color)) {
+      error = "a light needs a position or direction and a color";
+      return false;
+    }
+    scene.lights.push_back(light);
+  } else {
+    error = "unknown directive " + directive;
+    return false;
+  }
+  std::string rest;
+  if (words >> rest && rest[0] != '#') {
+    error = "unexpected " + rest;
+    return false;
+  }
+  return true;
+}
+
+bool LoadSceneText(const std::string& file_name, Scene& scene,
+                   std::string& error) {
+  std::ifstream in(file_name);
+  if (!in) {
+    error = "Could not open the scene file " + file_name + ".";
+    return false;
+  }
+  scene = Scene{};
+  std::map<std::string, int> material_ids;
+  std::vector<double> arrays[4];
+  std::vector<int> material_id;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(in, line)) {
+    line_number++;
+    std::string message;
+    if (!ParseLine(line, scene, material_ids, arrays, material_id, message)) {
+      error = file_name + ":" + std::to_string(line_number) + ": " + message +
+              ".";
+      return false;
+    }
+  }
+  scene.spheres.assign(int(material_id.size()), arrays[0].data(),
+                       arrays[1].data(), arrays[2].data(), arrays[3].data(),
+                       material_id.data());
+  return true;
+}
+
+void WriteVec3(std::ostream& out, const Vec3& v) {
+  out << v.x() << " " << v.y() << " " << v.z();
+}
+}  // namespace
+
+bool SceneFromObjects(const std::vector<std::shared_ptr<Hittable>>& objects,
+                      Scene& scene, std::string& error) {
+  scene = Scene{};
+  std::vector<double> arrays[4];
+  std::vector<int> material_id;
+  for (const auto& object : objects) {
+    auto sphere = std::dynamic_pointer_cast<Sphere>(object);
+    if (!sphere || sphere->material_id() < 0) {
+      error = "Only spheres with materials can be put into a scene.";
+      return false;
+    }
+    arrays[0].push_back(sphere->center().x());
+    arrays[1].push_back(sphere->center().y());
+    arrays[2].push_back(sphere->center().z());
+    arrays[3].push_back(sphere->radius());
+    material_id.push_back(sphere->material_id());
+  }
+  scene.spheres.assign(int(material_id.size()), arrays[0].data(),
+                       arrays[1].data(), arrays[2].data(), arrays[3].data(),
+                       material_id.data());
+  return true;
+}
+
+bool LoadScene(const std::string& file_name, Scene& scene,
+               std::string& error) {
+  char magic[sizeof(kBinaryMagic)] = {};
+  {
+    std::ifstream in(file_name, std::ios::binary);
+    if (!in) {
+      error = "Could not open the scene file " + file_name + ".";
+      return false;
+    }
+    in.read(magic, sizeof(magic));
+  }
+  scene = Scene{};
+  if (std::memcmp(magic, kBinaryMagic, sizeof(kBinaryMagic)) == 0) {
+    return LoadSceneBinary(file_name, scene, error);
+  }
+  return LoadSceneText(file_name, scene, error);
+}
+
+bool SaveSceneText(const std::string& file_name, const Scene& scene,
+                   std::string& error) {
+  std::ofstream out(file_name);
+  if (!out) {
+    error = "Could not create the scene file " + file_name + ".";
+    return false;
+  }
+  // Enough digits that every number reads back exactly.
+  out << std::setprecision(std::numeric_limits<double>::max_digits10);
+  // Names must be unique in the file; a repeated name gets a number.
+  std::vector<int> file_index;
+  std::vector<std::string> names;
+  std::set<std::string> used;
+  for (int id : UsedMaterials(scene, file_index)) {
+    const PhongParameters& material = Materials()[id];
+    std::string name = Materials().name(id);
+    for (int k = 2; used.count(name) != 0; k++) {
+      name = Materials().name(id) + " " + std::to_string(k);
+    }
+    used.insert(name);
+    names.push_back(name);
+    out << "material " << std::quoted(name) << " ";
+    WriteVec3(out, material.ambient);
+    out << "  ";
+    WriteVec3(out, material.diffuse);
+    out << "  ";
+    WriteVec3(out, material.specular);
+    out << "  " << material.shininess;
+    if (material.reflectance.length_squared() > 0) {
+      out << "  ";
+      WriteVec3(out, material.reflectance);
+    }
+    out << "\n";
+  }
+  if (scene.has_camera) {
+    out << "camera ";
+    WriteVec3(out, scene.camera.position);
+    out << "  ";
+    WriteVec3(out, scene.camera.look_at);
+    out << "  ";
+    WriteVec3(out, scene.camera.up);
+    out << "  " << scene.camera.vertical_fov << "\n";
+  }
+  for (const auto& light : scene.lights) {
+    out << "light "
+        << (light.type == Light::Type::kPoint ? "point " : "directional ");
+    WriteVec3(out, light.vector);
+    out << "  ";
+    WriteVec3(out, light.color);
+    out << "\n";
+  }
+  for (int i = 0; i < scene.spheres.size(); i++) {
+    out << "sphere ";
+    WriteVec3(out, scene.spheres.center(i));
+    out << " " << scene.spheres.radius(i) << " "
+        << std::quoted(names[file_index[scene.spheres.material_id(i)]])
+        << "\n";
+  }
+  if (!out) {
+    error = "Could not write the scene file " + file_name + ".";
+    return false;
+  }
+  return true;
+}
+
+bool SaveSceneBinary(const std::string& file_name, const Scene& scene,
+                     std::string& error) {
+  std::ofstream out(file_name, std::ios::binary);
+  if (!out) {
+    error = "Could not create the scene file " + file_name + ".";
+    return false;
+  }
+  auto write = [&out](const void* data, std::size_t size) {
+    out.write(static_cast<const char*>(data), std::streamsize(size));
+  };
+  std::string names;
+  std::vector<int> file_index;
+  std::vector<BinaryMaterial> materials;
+  for (int id : UsedMaterials(scene, file_index)) {
+    const PhongParameters& material = Materials()[id];
+    BinaryMaterial m{};
+    FromVec3(material.ambient, m.ambient);
+    FromVec3(material.diffuse, m.diffuse);
+    FromVec3(material.specular, m.specular);
+    m.shininess = material.shininess;
+    FromVec3(material.reflectance, m.reflectance);
+    m.name_offset = names.size();
+    m.name_size = Materials().name(id).size();
+    names += Materials().name(id);
+    materials.push_back(m);
+  }
+  int n = scene.spheres.size();
+  BinaryHeader header{};
+  std::memcpy(header.magic, kBinaryMagic, sizeof(kBinaryMagic));
+  header.version = kBinaryVersion;
+  header.byte_order = kByteOrderMark;
+  header.num_materials = materials.size();
+  header.num_spheres = std::uint64_t(n);
+  header.num_lights = scene.lights.size();
+  header.names_size = names.size();
+  header.has_camera = scene.has_camera ? 1 : 0;
+  write(&header, sizeof(header));
+
+  BinaryCamera camera{};
+  FromVec3(scene.camera.position, camera.position);
+  FromVec3(scene.camera.look_at, camera.look_at);
+  FromVec3(scene.camera.up, camera.up);
+  camera.vertical_fov = scene.camera.vertical_fov;
+  write(&camera, sizeof(camera));
+  write(materials.data(), materials.size() * sizeof(BinaryMaterial));
+  for (const auto& light : scene.lights) {
+    BinaryLight l{};
+    l.type = light.type == Light::Type::kPoint ? 0 : 1;
+    FromVec3(light.vector, l.vector);
+    FromVec3(light.color, l.color);
+    write(&l, sizeof(l));
+  }
+
+  std::vector<double> column(n);
+  for (int axis = 0; axis < 3; axis++) {
+    for (int i = 0; i < n; i++) {
+      column[i] = scene.spheres.center(i)[axis];
+    }
+    write(column.data(), column.size() * sizeof(double));
+  }
+  for (int i = 0; i < n; i++) {
+    column[i] = scene.spheres.radius(i);
+  }
+  write(column.data(), column.size() * sizeof(double));
+  std::vector<std::int32_t> material_index(IndexBytes(n) /
+                                           sizeof(std::int32_t));
+  for (int i = 0; i < n; i++) {
+    material_index[i] = file_index[scene.spheres.material_id(i)];
+  }
+  write(material_index.data(), material_index.size() * sizeof(std::int32_t));
+  write(names.data(), names.size());
+  if (!out) {
+    error = "Could not write the scene file " + file_name + ".";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,87 @@
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "camera.h"
+#include "hittable.h"
+#include "light.h"
+#include "material_table.h"
+#include "sphere_set.h"
+#include "vec3.h"
+
+/// A Scene is everything a scene file describes: the spheres, the camera
+/// and the lights. The spheres are kept in a SphereSet; the materials a
+/// file defines are added to the MaterialTable, Materials(), and the
+/// spheres refer to them by ID.
+///
+/// Scenes are read from and written to two formats. The text format is
+/// meant to be written by hand; every line is a directive, and # starts
+/// a comment:
+/// \code
+/// material "Plain Yellow" 0.3 0.3 0 0.7 0.7 0 0.5 0.5 0 32
+/// material "Mirror" 0 0 0 0.1 0.1 0.1 0.5 0.5 0.5 128 0.8 0.8 0.8
+/// sphere 0 0 -1 0.5 "Plain Yellow"
+/// camera 0 0 0 0 0 -1 0 1 0 90
+/// light point 20 20 -1 800 800 800
+/// light directional -1 -1 -1 0.5 0.5 0.5
+/// \endcode
+/// A material gives its name, ambient, diffuse and specular colors,
+/// shininess and, for a mirror, its reflectance; a sphere its center,
+/// radius and the name of a material defined before it; the camera its
+/// position, the point it looks at, the up direction and the vertical field
+/// of view in degrees; a light its type, position or direction, and color.
+/// A point light's color is its color at a distance of 1, see Light. A
+/// scene with no lights is lit by DefaultLights().
+///
+/// The binary format is a cache of the same scene which is loaded without
+/// any parsing: the file is memory mapped and the sphere arrays, stored in
+/// the very layout SphereSet uses, are copied out in bulk. A million
+/// sphere scene loads in milliseconds.
+struct Scene {
+  /// The spheres
+  SphereSet spheres;
+  /// The camera; its aspect ratio is left to the image being rendered
+  CameraView camera;
+  /// True if the scene gave a camera, false if camera holds the defaults
+  bool has_camera = false;
+  /// The lights
+  std::vector<Light> lights;
+};
+
+/// Make a Scene out of the \p objects such as those returned by
+/// RandomScene(). Every object must be a Sphere with a material.
+/// \param objects The objects to put into the scene
+/// \param scene The scene to fill in
+/// \param error A description of the problem when an object is not a
+/// sphere with a material
+/// \returns true on success else false
+bool SceneFromObjects(const std::vector<std::shared_ptr<Hittable>>& objects,
+                      Scene& scene, std::string& error);
+
+/// Read the scene in \p file_name, which may be in either the text or the
+/// binary format; binary files are recognized by their first bytes.
+/// \param file_name The path to the scene file
+/// \param scene The scene to fill in
+///
+/// The scene's materials are added to Materials() as they are read. The
+/// table only grows, so a load which fails part way through leaves the
+/// materials read before the failure in it, unused.
+/// \param error A description of the problem when loading fails, such as
+/// the line of a text file which could not be understood
+/// \returns true on success else false
+bool LoadScene(const std::string& file_name, Scene& scene, std::string& error);
+
+/// Write \p scene to \p file_name in the text format.
+/// \returns true on success else false with a description in \p error
+bool SaveSceneText(const std::string& file_name, const Scene& scene,
+                   std::string& error);
+
+/// Write \p scene to \p file_name in the binary format.
+/// \returns true on success else false with a description in \p error
+bool SaveSceneBinary(const std::string& file_name, const Scene& scene,
+                     std::string& error);
+
+#endif
@@ -7,40 +7,35 @@
 
 Point3 Sphere::center() const { return center_; }
 
-double Sphere::radius() const { return radius_; }
+Real Sphere::radius() const { return radius_; }
 
-std::shared_ptr<Material> Sphere::material() const { return material_; }
+int Sphere::material_id() const { return material_id_; }
 
-bool Sphere::hit(const Ray& r, double t_min, double t_max,
+bool Sphere::hit(const Ray& r, Real t_min, Real t_max,
                  HitRecord& rec) const {
   // Get a vector from the ray's origin to the sphere's center
   Vec3 oc = r.origin() - center_;
   // t^2 d \cdot d + 2 t d \cdot (O - C) + (O - C) \cdot (O - C) - r^2 = 0
-  // where a is t^2  d \cdot d
-  // b is 2 t d \cdot (O - C) + (O - C)
+  // where a is d \cdot d
+  // half_b is d \cdot (O - C), half of the coefficient of t
   // and c is (O - C) \cdot (O - C) - r^2
-  double a = Dot(r.direction(), r.direction());
-  double b = 2.0 * Dot(oc, r.direction());
-  double c = Dot(oc, oc) - Square(radius_);
-  // If the discriminant is greater than zero then the ray strikes the
-  // sphere 1 or more times; else the ray does not strike the sphere
-  double discriminant = Square(b) - (4 * a * c);
-
-  // Short circuit out of the function if the discriminant is less than zero.
-  // There are no real roots when discriminant is less than zero.
-  if (discriminant < 0) {
+  Real a = Dot(r.direction(), r.direction());
+  Real half_b = Dot(oc, r.direction());
+  Real c = Dot(oc, oc) - Square(radius_);
+  Real near = 0;
+  Real far = 0;
+  // There are no real roots, the ray misses the sphere, when the
+  // discriminant is less than zero.
+  if (!SphereRoots(a, half_b, c, near, far)) {
     return false;
   }
 
-  auto discriminant_sqrt = std::sqrt(discriminant);
   // return the solution that is on the closest side of the sphere
-  // Apply the quadratic equation
-  // x = \frac{-b \pm \sqrt{b^2 - 4ac}}{2a}
-  auto root = (-b - discriminant_sqrt) / (2.0 * a);
+  Real root = near;
   // If our solution is outside of our ray's t_min and t_max
   if (root < t_min || t_max < root) {
     // Look at the other solution
-    root = (-b + discriminant_sqrt) / (2.0 * a);
+    root = far;
     // If our solution is outside of our ray's t_min and t_max
     if (root < t_min || t_max < root) {
       // Again short circuit out.
@@ -51,14 +46,31 @@ bool Sphere::hit(const Ray& r, double t_min, double t_max,
   rec.t = root;
   rec.p = r.at(rec.t);
   rec.normal = (rec.p - center_) / radius_;
-  rec.material = material_;
+  rec.material_id = material_id_;
   return true;
 }
 
+bool Sphere::occluded(const Ray& r, Real t_max) const {
+  Vec3 oc = r.origin() - center_;
+  Real near = 0;
+  Real far = 0;
+  if (!SphereRoots(Dot(r.direction(), r.direction()), Dot(oc, r.direction()),
+                   Dot(oc, oc) - Square(radius_), near, far)) {
+    return false;
+  }
+  return (near >= 0 && near <= t_max) || (far >= 0 && far <= t_max);
+}
+
+AABB Sphere::bounding_box() const {
+  Vec3 extent{radius_, radius_, radius_};
+  return AABB{center_ - extent, center_ + extent};
+}
+
 std::ostream& operator<<(std::ostream& out, const Sphere& s) {
-  // Fetching the name only works for Phong materials.
-  auto m = std::dynamic_pointer_cast<PhongMaterial>(s.material());
   out << "Sphere(center=" << s.center() << ", radius=" << s.radius()
-      << ", material=\"" << m->name() << "\")";
+      << ", material=\""
+      << (s.material_id() < 0 ? MaterialTable::kNoName
+                              : Materials().name(s.material_id()))
+      << "\")";
   return out;
 }
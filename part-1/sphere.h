@@ -11,6 +11,35 @@
 #include "ray.h"
 #include "vec3.h"
 
+/// Solve a t^2 + 2 half_b t + c = 0, the equation for where a ray meets a
+/// sphere, for its two roots \p near <= \p far.
+/// The textbook form (-half_b +- sqrt(discriminant)) / a subtracts two
+/// nearly equal numbers for one of the roots whenever the sphere is small
+/// or far away, and the cancellation puts the hit point visibly off the
+/// surface in a float build. Here q = -(half_b + sign(half_b) sqrt(D)) adds
+/// numbers of the same sign so nothing cancels, and the roots are q / a and
+/// c / q. See [Numerical Recipes, section 5.6]
+/// (https://numerical.recipes/book.html).
+/// \param a The dot product of the ray's direction with itself
+/// \param half_b The dot product of the direction and origin - center
+/// \param c (origin - center) dotted with itself minus the radius squared
+/// \param near Set to the smaller root
+/// \param far Set to the larger root
+/// \returns false if the ray misses the sphere, leaving near and far alone
+inline bool SphereRoots(Real a, Real half_b, Real c, Real& near, Real& far) {
+  Real discriminant = half_b * half_b - a * c;
+  if (!(discriminant >= 0)) {
+    return false;
+  }
+  Real q = -(half_b + std::copysign(std::sqrt(discriminant), half_b));
+  Real root0 = q / a;
+  Real root1 = c / q;
+  // When q is 0 so is c, and 0 / 0 is NaN; a NaN root1 yields root0.
+  near = root1 < root0 ? root1 : root0;
+  far = root1 > root0 ? root1 : root0;
+  return true;
+}
+
 /// A sphere is defined by a center and a radius. It is a `hittable` object
 /// so it implements the hittable interface and can be intersected with
 /// a ray.
@@ -19,22 +48,32 @@ class Sphere : public Hittable {
   /// The center of the sphere
   Point3 center_;
   /// The radius of the sphere
-  double radius_;
-  /// The material properties of the sphere
-  std::shared_ptr<Material> material_;
+  Real radius_;
+  /// The ID of the sphere's material in Materials()
+  int material_id_;
 
  public:
   /// Construct a sphere given a point in space and a radius
   /// \param center The center of the sphere
   /// \param radius The radius of the pshere
   /// \param material A pointer to material properties
-  Sphere(Point3 center, double radius, std::shared_ptr<Material> material)
-      : center_(center), radius_(radius), material_{material} {};
+  Sphere(Point3 center, double radius,
+         const std::shared_ptr<Material>& material)
+      : center_(center),
+        radius_(radius),
+        material_id_{material ? material->id() : -1} {};
+  /// Construct a sphere given a point in space, a radius and the ID of a
+  /// material in Materials()
+  /// \param center The center of the sphere
+  /// \param radius The radius of the pshere
+  /// \param material_id The ID of the sphere's material
+  Sphere(Point3 center, double radius, int material_id)
+      : center_(center), radius_(radius), material_id_{material_id} {};
   /// Construct a sphere given a point in space and a radius
   /// \param center The center of the sphere
   /// \param radius The radius of the pshere
   Sphere(Point3 center, double radius)
-      : center_(center), radius_(radius), material_{nullptr} {};
+      : center_(center), radius_(radius), material_id_{-1} {};
 
   ~Sphere() override = default;
 
@@ -49,9 +88,10 @@ class Sphere : public Hittable {
   /// Return the center of the sphere
   Point3 center() const;
   /// Return the radius of the sphere
-  double radius() const;
-  /// Return the sphere's material pointer
-  std::shared_ptr<Material> material() const;
+  Real radius() const;
+  /// Return the ID of the sphere's material in Materials(), or -1 if the
+  /// sphere has no material
+  int material_id() const;
 
   /// Override the hittable hit() method with one that is correct for spheres.
   /// The ray \p r is tested over the interval \p t_min to \p t_max for
@@ -64,8 +104,18 @@ class Sphere : public Hittable {
   /// intersection
   /// \param rec The HitRecord to store the data needed for shading
   /// \remarks This overrides the method defined in the Hittable class.
-  bool hit(const Ray& r, double t_min, double t_max,
+  bool hit(const Ray& r, Real t_min, Real t_max,
            HitRecord& rec) const override;
+
+  /// Override the hittable occluded() method; the roots are checked
+  /// without computing the hit point or normal.
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool occluded(const Ray& r, Real t_max) const override;
+
+  /// Override the hittable bounding_box() method; the box around a sphere
+  /// is its center plus and minus the radius on each axis.
+  /// \remarks This overrides the method defined in the Hittable class.
+  AABB bounding_box() const override;
 };
 
 /// Output a sphere to an ostream
@@ -0,0 +1,486 @@
+#include "sphere_set.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SPHERE_SET_X86 1
+#include <immintrin.h>
+#endif
+
+// See the header file for documentation.
+
+namespace {
+// Every array carries this many extra NaN spheres at the end so the SIMD
+// kernels can always load a full register, eight floats in a float build.
+// A NaN sphere is never hit.
+const int kPadding = 8;
+
+// Raw pointers to the arrays handed to a kernel.
+struct SphereArrays {
+  const Real* x;
+  const Real* y;
+  const Real* z;
+  const Real* radius;
+};
+
+// A kernel tests a ray against spheres [first, first + count) and returns
+// the index of the closest one struck, or -1. t_max is lowered to the hit.
+using Kernel = int (*)(const SphereArrays& s, int first, int count,
+                       const Point3& origin, const Vec3& direction,
+                       Real t_min, Real& t_max);
+
+// A packet kernel tests every lane of a packet against spheres
+// [first, first + count), lowering t_max and recording the sphere index
+// of each lane's closest hit in closest.
+using PacketKernel = void (*)(const SphereArrays& s, int first, int count,
+                              RayPacket& packet, Real t_min, int* closest);
+
+// The quadratic is solved in the half-b form with the stable roots of
+// SphereRoots(); every kernel returns the very same roots as Sphere::hit().
+int HitScalar(const SphereArrays& s, int first, int count,
+              const Point3& origin, const Vec3& direction, Real t_min,
+              Real& t_max) {
+  Real a = Dot(direction, direction);
+  int closest = -1;
+  for (int i = first; i < first + count; i++) {
+    Real ocx = origin.x() - s.x[i];
+    Real ocy = origin.y() - s.y[i];
+    Real ocz = origin.z() - s.z[i];
+    Real half_b = ocx * direction.x() + ocy * direction.y() +
+                  ocz * direction.z();
+    Real c = (ocx * ocx + ocy * ocy + ocz * ocz) - s.radius[i] * s.radius[i];
+    Real near = 0;
+    Real far = 0;
+    if (!SphereRoots(a, half_b, c, near, far)) {
+      continue;
+    }
+    Real root = near;
+    if (root < t_min || t_max < root) {
+      root = far;
+      if (root < t_min || t_max < root) {
+        continue;
+      }
+    }
+    t_max = root;
+    closest = i;
+  }
+  return closest;
+}
+
+// The lanes are the innermost loop and the selects are branch free so the
+// compiler can turn the loop body into SSE2 instructions.
+void HitPacketScalar(const SphereArrays& s, int first, int count,
+                     RayPacket& packet, Real t_min, int* closest) {
+  const Real kInf = std::numeric_limits<Real>::infinity();
+  Real a[kPacketSize];
+  for (int lane = 0; lane < kPacketSize; lane++) {
+    a[lane] = packet.direction[0][lane] * packet.direction[0][lane] +
+              packet.direction[1][lane] * packet.direction[1][lane] +
+              packet.direction[2][lane] * packet.direction[2][lane];
+  }
+  for (int i = first; i < first + count; i++) {
+    for (int lane = 0; lane < kPacketSize; lane++) {
+      Real ocx = packet.origin[0][lane] - s.x[i];
+      Real ocy = packet.origin[1][lane] - s.y[i];
+      Real ocz = packet.origin[2][lane] - s.z[i];
+      Real half_b = ocx * packet.direction[0][lane] +
+                    ocy * packet.direction[1][lane] +
+                    ocz * packet.direction[2][lane];
+      Real c =
+          (ocx * ocx + ocy * ocy + ocz * ocz) - s.radius[i] * s.radius[i];
+      Real discriminant = half_b * half_b - a[lane] * c;
+      Real q = -(half_b + std::copysign(std::sqrt(discriminant >= 0
+                                                      ? discriminant
+                                                      : Real(0)),
+                                        half_b));
+      Real root0 = q / a[lane];
+      Real root1 = c / q;
+      Real near = root1 < root0 ? root1 : root0;
+      Real far = root1 > root0 ? root1 : root0;
+      Real t_max = packet.t_max[lane];
+      bool hit = discriminant >= 0;
+      bool near_ok = hit && near >= t_min && near <= t_max;
+      bool far_ok = hit && far >= t_min && far <= t_max;
+      Real t = near_ok ? near : (far_ok ? far : kInf);
+      bool struck = near_ok || far_ok;
+      packet.t_max[lane] = struck ? t : t_max;
+      closest[lane] = struck ? i : closest[lane];
+    }
+  }
+}
+
+#ifdef SPHERE_SET_X86
+// The SSE2 and AVX2 kernels are written once for both precisions:
+// SSE(add) names _mm_add_pd in a double build and _mm_add_ps in a float
+// build, and AVX(add) the same for _mm256_add_pd and _mm256_add_ps.
+#ifdef RT_FLOAT
+#define SSE(op) _mm_##op##_ps
+#define AVX(op) _mm256_##op##_ps
+using SseReal = __m128;
+using AvxReal = __m256;
+#else
+#define SSE(op) _mm_##op##_pd
+#define AVX(op) _mm256_##op##_pd
+using SseReal = __m128d;
+using AvxReal = __m256d;
+#endif
+// The number of Reals in an SSE and in an AVX register
+const int kSseWidth = 16 / sizeof(Real);
+const int kAvxWidth = 32 / sizeof(Real);
+// Loaded to number the lanes of a register
+alignas(32) const Real kLaneNumbers[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+
+int HitSse2(const SphereArrays& s, int first, int count, const Point3& origin,
+            const Vec3& direction, Real t_min, Real& t_max) {
+  const SseReal kInf = SSE(set1)(std::numeric_limits<Real>::infinity());
+  const SseReal kSign = SSE(set1)(-0.0);
+  const SseReal kLanes = SSE(load)(kLaneNumbers);
+  SseReal ox = SSE(set1)(origin.x());
+  SseReal oy = SSE(set1)(origin.y());
+  SseReal oz = SSE(set1)(origin.z());
+  SseReal dx = SSE(set1)(direction.x());
+  SseReal dy = SSE(set1)(direction.y());
+  SseReal dz = SSE(set1)(direction.z());
+  SseReal a = SSE(set1)(Dot(direction, direction));
+  SseReal low = SSE(set1)(t_min);
+  int closest = -1;
+  for (int i = first; i < first + count; i += kSseWidth) {
+    SseReal high = SSE(set1)(t_max);
+    SseReal ocx = SSE(sub)(ox, SSE(loadu)(s.x + i));
+    SseReal ocy = SSE(sub)(oy, SSE(loadu)(s.y + i));
+    SseReal ocz = SSE(sub)(oz, SSE(loadu)(s.z + i));
+    SseReal r = SSE(loadu)(s.radius + i);
+    SseReal half_b = SSE(add)(SSE(add)(SSE(mul)(ocx, dx), SSE(mul)(ocy, dy)),
+                              SSE(mul)(ocz, dz));
+    SseReal c = SSE(sub)(
+        SSE(add)(SSE(add)(SSE(mul)(ocx, ocx), SSE(mul)(ocy, ocy)),
+                 SSE(mul)(ocz, ocz)),
+        SSE(mul)(r, r));
+    SseReal discriminant =
+        SSE(sub)(SSE(mul)(half_b, half_b), SSE(mul)(a, c));
+    SseReal hit =
+        SSE(and)(SSE(cmpge)(discriminant, SSE(setzero)()),
+                 SSE(cmplt)(kLanes, SSE(set1)(first + count - i)));
+    if (SSE(movemask)(hit) == 0) {
+      continue;
+    }
+    // q = -(half_b + copysign(sqrt(discriminant), half_b))
+    SseReal signed_sqrt = SSE(or)(SSE(sqrt)(discriminant),
+                                  SSE(and)(half_b, kSign));
+    SseReal q = SSE(sub)(SSE(setzero)(), SSE(add)(half_b, signed_sqrt));
+    SseReal root0 = SSE(div)(q, a);
+    SseReal root1 = SSE(div)(c, q);
+    SseReal near = SSE(min)(root1, root0);
+    SseReal far = SSE(max)(root1, root0);
+    SseReal near_ok = SSE(and)(
+        hit, SSE(and)(SSE(cmpge)(near, low), SSE(cmple)(near, high)));
+    SseReal far_ok = SSE(and)(
+        hit, SSE(and)(SSE(cmpge)(far, low), SSE(cmple)(far, high)));
+    SseReal t = SSE(or)(SSE(and)(far_ok, far), SSE(andnot)(far_ok, kInf));
+    t = SSE(or)(SSE(and)(near_ok, near), SSE(andnot)(near_ok, t));
+    int struck = SSE(movemask)(SSE(or)(near_ok, far_ok));
+    alignas(16) Real lanes[kSseWidth];
+    SSE(store)(lanes, t);
+    for (int lane = 0; lane < kSseWidth; lane++) {
+      if ((struck & (1 << lane)) != 0 && lanes[lane] <= t_max) {
+        t_max = lanes[lane];
+        closest = i + lane;
+      }
+    }
+  }
+  return closest;
+}
+
+__attribute__((target("avx2"))) int HitAvx2(const SphereArrays& s, int first,
+                                            int count, const Point3& origin,
+                                            const Vec3& direction, Real t_min,
+                                            Real& t_max) {
+  const AvxReal kInf = AVX(set1)(std::numeric_limits<Real>::infinity());
+  const AvxReal kSign = AVX(set1)(-0.0);
+  const AvxReal kLanes = AVX(load)(kLaneNumbers);
+  AvxReal ox = AVX(set1)(origin.x());
+  AvxReal oy = AVX(set1)(origin.y());
+  AvxReal oz = AVX(set1)(origin.z());
+  AvxReal dx = AVX(set1)(direction.x());
+  AvxReal dy = AVX(set1)(direction.y());
+  AvxReal dz = AVX(set1)(direction.z());
+  AvxReal a = AVX(set1)(Dot(direction, direction));
+  AvxReal low = AVX(set1)(t_min);
+  int closest = -1;
+  for (int i = first; i < first + count; i += kAvxWidth) {
+    AvxReal high = AVX(set1)(t_max);
+    AvxReal ocx = AVX(sub)(ox, AVX(loadu)(s.x + i));
+    AvxReal ocy = AVX(sub)(oy, AVX(loadu)(s.y + i));
+    AvxReal ocz = AVX(sub)(oz, AVX(loadu)(s.z + i));
+    AvxReal r = AVX(loadu)(s.radius + i);
+    AvxReal half_b = AVX(add)(AVX(add)(AVX(mul)(ocx, dx), AVX(mul)(ocy, dy)),
+                              AVX(mul)(ocz, dz));
+    AvxReal c = AVX(sub)(
+        AVX(add)(AVX(add)(AVX(mul)(ocx, ocx), AVX(mul)(ocy, ocy)),
+                 AVX(mul)(ocz, ocz)),
+        AVX(mul)(r, r));
+    AvxReal discriminant =
+        AVX(sub)(AVX(mul)(half_b, half_b), AVX(mul)(a, c));
+    AvxReal hit = AVX(and)(
+        AVX(cmp)(discriminant, AVX(setzero)(), _CMP_GE_OQ),
+        AVX(cmp)(kLanes, AVX(set1)(first + count - i), _CMP_LT_OQ));
+    if (AVX(movemask)(hit) == 0) {
+      continue;
+    }
+    // q = -(half_b + copysign(sqrt(discriminant), half_b))
+    AvxReal signed_sqrt = AVX(or)(AVX(sqrt)(discriminant),
+                                  AVX(and)(half_b, kSign));
+    AvxReal q = AVX(sub)(AVX(setzero)(), AVX(add)(half_b, signed_sqrt));
+    AvxReal root0 = AVX(div)(q, a);
+    AvxReal root1 = AVX(div)(c, q);
+    AvxReal near = AVX(min)(root1, root0);
+    AvxReal far = AVX(max)(root1, root0);
+    AvxReal near_ok = AVX(and)(
+        hit, AVX(and)(AVX(cmp)(near, low, _CMP_GE_OQ),
+                      AVX(cmp)(near, high, _CMP_LE_OQ)));
+    AvxReal far_ok = AVX(and)(
+        hit, AVX(and)(AVX(cmp)(far, low, _CMP_GE_OQ),
+                      AVX(cmp)(far, high, _CMP_LE_OQ)));
+    AvxReal t = AVX(blendv)(kInf, far, far_ok);
+    t = AVX(blendv)(t, near, near_ok);
+    int struck = AVX(movemask)(AVX(or)(near_ok, far_ok));
+    alignas(32) Real lanes[kAvxWidth];
+    AVX(store)(lanes, t);
+    for (int lane = 0; lane < kAvxWidth; lane++) {
+      if ((struck & (1 << lane)) != 0 && lanes[lane] <= t_max) {
+        t_max = lanes[lane];
+        closest = i + lane;
+      }
+    }
+  }
+  return closest;
+}
+
+#ifdef RT_FLOAT
+// A packet of four floats fills only half of a ymm register; the portable
+// packet kernel vectorizes to the very same four lanes.
+const PacketKernel HitPacketAvx2 = HitPacketScalar;
+#else
+// Each sphere's center and radius are broadcast and tested against the
+// four rays of the packet, one ray per lane.
+__attribute__((target("avx2"))) void HitPacketAvx2(const SphereArrays& s,
+                                                   int first, int count,
+                                                   RayPacket& packet,
+                                                   Real t_min,
+                                                   int* closest) {
+  static_assert(kPacketSize == 4, "HitPacketAvx2 holds a packet in a ymm");
+  const __m256d kSign = _mm256_set1_pd(-0.0);
+  __m256d ox = _mm256_load_pd(packet.origin[0]);
+  __m256d oy = _mm256_load_pd(packet.origin[1]);
+  __m256d oz = _mm256_load_pd(packet.origin[2]);
+  __m256d dx = _mm256_load_pd(packet.direction[0]);
+  __m256d dy = _mm256_load_pd(packet.direction[1]);
+  __m256d dz = _mm256_load_pd(packet.direction[2]);
+  __m256d a = _mm256_add_pd(
+      _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)),
+      _mm256_mul_pd(dz, dz));
+  __m256d low = _mm256_set1_pd(t_min);
+  __m256d high = _mm256_load_pd(packet.t_max);
+  __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(closest));
+  for (int i = first; i < first + count; i++) {
+    __m256d ocx = _mm256_sub_pd(ox, _mm256_set1_pd(s.x[i]));
+    __m256d ocy = _mm256_sub_pd(oy, _mm256_set1_pd(s.y[i]));
+    __m256d ocz = _mm256_sub_pd(oz, _mm256_set1_pd(s.z[i]));
+    __m256d r = _mm256_set1_pd(s.radius[i]);
+    __m256d half_b = _mm256_add_pd(
+        _mm256_add_pd(_mm256_mul_pd(ocx, dx), _mm256_mul_pd(ocy, dy)),
+        _mm256_mul_pd(ocz, dz));
+    __m256d c = _mm256_sub_pd(
+        _mm256_add_pd(
+            _mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)),
+            _mm256_mul_pd(ocz, ocz)),
+        _mm256_mul_pd(r, r));
+    __m256d discriminant =
+        _mm256_sub_pd(_mm256_mul_pd(half_b, half_b), _mm256_mul_pd(a, c));
+    __m256d hit = _mm256_cmp_pd(discriminant, _mm256_setzero_pd(), _CMP_GE_OQ);
+    if (_mm256_movemask_pd(hit) == 0) {
+      continue;
+    }
+    __m256d signed_sqrt = _mm256_or_pd(_mm256_sqrt_pd(discriminant),
+                                       _mm256_and_pd(half_b, kSign));
+    __m256d q = _mm256_sub_pd(_mm256_setzero_pd(),
+                              _mm256_add_pd(half_b, signed_sqrt));
+    __m256d root0 = _mm256_div_pd(q, a);
+    __m256d root1 = _mm256_div_pd(c, q);
+    __m256d near = _mm256_min_pd(root1, root0);
+    __m256d far = _mm256_max_pd(root1, root0);
+    __m256d near_ok = _mm256_and_pd(
+        hit, _mm256_and_pd(_mm256_cmp_pd(near, low, _CMP_GE_OQ),
+                           _mm256_cmp_pd(near, high, _CMP_LE_OQ)));
+    __m256d far_ok = _mm256_and_pd(
+        hit, _mm256_and_pd(_mm256_cmp_pd(far, low, _CMP_GE_OQ),
+                           _mm256_cmp_pd(far, high, _CMP_LE_OQ)));
+    __m256d struck = _mm256_or_pd(near_ok, far_ok);
+    if (_mm256_movemask_pd(struck) == 0) {
+      continue;
+    }
+    __m256d t = _mm256_blendv_pd(far, near, near_ok);
+    high = _mm256_blendv_pd(high, t, struck);
+    // Narrow the 64 bit lane masks to 32 bits to select the new indices.
+    __m128i lanes = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(
+        _mm256_castpd_si256(struck), _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4,
+                                                       6)));
+    index = _mm_blendv_epi8(index, _mm_set1_epi32(i), lanes);
+  }
+  _mm256_store_pd(packet.t_max, high);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(closest), index);
+}
+#endif
+#undef SSE
+#undef AVX
+#endif
+
+struct KernelChoice {
+  Kernel kernel;
+  PacketKernel packet_kernel;
+  const char* name;
+};
+
+KernelChoice BestKernel() {
+#ifdef SPHERE_SET_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return KernelChoice{HitAvx2, HitPacketAvx2, "avx2"};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return KernelChoice{HitSse2, HitPacketScalar, "sse2"};
+  }
+#endif
+  return KernelChoice{HitScalar, HitPacketScalar, "scalar"};
+}
+
+// The kernel picked for this CPU when the program starts.
+KernelChoice active_kernel = BestKernel();
+}  // namespace
+
+SphereSet::SphereSet()
+    : center_x_(kPadding, std::numeric_limits<Real>::quiet_NaN()),
+      center_y_(kPadding, std::numeric_limits<Real>::quiet_NaN()),
+      center_z_(kPadding, std::numeric_limits<Real>::quiet_NaN()),
+      radius_(kPadding, std::numeric_limits<Real>::quiet_NaN()) {}
+
+void SphereSet::add(const Point3& center, Real radius, int material_id) {
+  // Overwrite the first padding sphere and put a new one at the end.
+  std::size_t i = material_id_.size();
+  center_x_[i] = center.x();
+  center_y_[i] = center.y();
+  center_z_[i] = center.z();
+  radius_[i] = radius;
+  center_x_.push_back(std::numeric_limits<Real>::quiet_NaN());
+  center_y_.push_back(std::numeric_limits<Real>::quiet_NaN());
+  center_z_.push_back(std::numeric_limits<Real>::quiet_NaN());
+  radius_.push_back(std::numeric_limits<Real>::quiet_NaN());
+  material_id_.push_back(material_id);
+}
+
+void SphereSet::add(const Sphere& s) {
+  add(s.center(), s.radius(), s.material_id());
+}
+
+void SphereSet::assign(int count, const double* x, const double* y,
+                       const double* z, const double* radius,
+                       const int* material_id) {
+  const Real kNaN = std::numeric_limits<Real>::quiet_NaN();
+  center_x_.assign(x, x + count);
+  center_y_.assign(y, y + count);
+  center_z_.assign(z, z + count);
+  radius_.assign(radius, radius + count);
+  center_x_.resize(count + kPadding, kNaN);
+  center_y_.resize(count + kPadding, kNaN);
+  center_z_.resize(count + kPadding, kNaN);
+  radius_.resize(count + kPadding, kNaN);
+  material_id_.assign(material_id, material_id + count);
+}
+
+int SphereSet::size() const { return int(material_id_.size()); }
+
+Point3 SphereSet::center(int i) const {
+  return Point3{center_x_[i], center_y_[i], center_z_[i]};
+}
+
+Real SphereSet::radius(int i) const { return radius_[i]; }
+
+AABB SphereSet::bounding_box(int i) const {
+  Vec3 extent{radius_[i], radius_[i], radius_[i]};
+  return AABB{center(i) - extent, center(i) + extent};
+}
+
+int SphereSet::material_id(int i) const { return material_id_[i]; }
+
+bool SphereSet::hit(const Ray& r, int first, int count, Real t_min,
+                    Real t_max, HitRecord& rec) const {
+  SphereArrays arrays{center_x_.data(), center_y_.data(), center_z_.data(),
+                      radius_.data()};
+  int i = active_kernel.kernel(arrays, first, count, r.origin(),
+                               r.direction(), t_min, t_max);
+  if (i < 0) {
+    return false;
+  }
+  record(r, i, t_max, rec);
+  return true;
+}
+
+bool SphereSet::occluded(const Ray& r, int first, int count,
+                         Real t_max) const {
+  SphereArrays arrays{center_x_.data(), center_y_.data(), center_z_.data(),
+                      radius_.data()};
+  return active_kernel.kernel(arrays, first, count, r.origin(),
+                              r.direction(), 0, t_max) >= 0;
+}
+
+void SphereSet::hit_packet(RayPacket& packet, int first, int count,
+                           Real t_min, int* closest) const {
+  SphereArrays arrays{center_x_.data(), center_y_.data(), center_z_.data(),
+                      radius_.data()};
+  active_kernel.packet_kernel(arrays, first, count, packet, t_min, closest);
+}
+
+void SphereSet::record(const Ray& r, int i, Real t, HitRecord& rec) const {
+  rec.t = t;
+  rec.p = r.at(rec.t);
+  rec.normal = (rec.p - center(i)) / radius_[i];
+  rec.material_id = material_id_[i];
+}
+
+bool SphereSet::hit(const Ray& r, Real t_min, Real t_max,
+                    HitRecord& rec) const {
+  return hit(r, 0, size(), t_min, t_max, rec);
+}
+
+bool SphereSet::occluded(const Ray& r, Real t_max) const {
+  return occluded(r, 0, size(), t_max);
+}
+
+AABB SphereSet::bounding_box() const {
+  AABB box;
+  for (int i = 0; i < size(); i++) {
+    box.expand(bounding_box(i));
+  }
+  return box;
+}
+
+std::string SphereSet::kernel_name() { return active_kernel.name; }
+
+bool SphereSet::select_kernel(const std::string& name) {
+  if (name == "scalar") {
+    active_kernel = KernelChoice{HitScalar, HitPacketScalar, "scalar"};
+    return true;
+  }
+#ifdef SPHERE_SET_X86
+  if (name == "sse2" && __builtin_cpu_supports("sse2")) {
+    active_kernel = KernelChoice{HitSse2, HitPacketScalar, "sse2"};
+    return true;
+  }
+  if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+    active_kernel = KernelChoice{HitAvx2, HitPacketAvx2, "avx2"};
+    return true;
+  }
+#endif
+  return false;
+}
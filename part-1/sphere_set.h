@@ -0,0 +1,141 @@
+#ifndef _SPHERE_SET_H_
+#define _SPHERE_SET_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aabb.h"
+#include "hittable.h"
+#include "material.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "sphere.h"
+#include "vec3.h"
+
+/// A SphereSet packs many spheres into a structure of arrays (SoA): one
+/// array of center x values, one of center y values, one of center z
+/// values, one of radii, and one of material IDs. Laying the spheres
+/// out this way lets a single SIMD instruction work on several spheres at
+/// once and avoids chasing a pointer and making a virtual call per sphere.
+/// See [AoS and SoA](https://en.wikipedia.org/wiki/AoS_and_SoA).
+///
+/// The intersection kernel is chosen once, when the program starts, from
+/// the instruction sets the CPU supports: AVX2 (4 spheres at a time, 8 in a
+/// float build), SSE2 (2 spheres at a time, 4 in a float build), or a
+/// portable scalar loop. Every kernel computes
+/// exactly the same values as Sphere::hit(). A RayPacket is tested the
+/// other way around: each sphere is tested against all of the packet's
+/// rays at once, one ray per SIMD lane.
+class SphereSet : public Hittable {
+ private:
+  /// The x coordinates of the sphere centers
+  std::vector<Real> center_x_;
+  /// The y coordinates of the sphere centers
+  std::vector<Real> center_y_;
+  /// The z coordinates of the sphere centers
+  std::vector<Real> center_z_;
+  /// The radii of the spheres
+  std::vector<Real> radius_;
+  /// The ID in Materials() of each sphere's material
+  std::vector<int> material_id_;
+
+ public:
+  SphereSet();
+
+  /// Append a sphere to the set
+  /// \param center The center of the sphere
+  /// \param radius The radius of the sphere
+  /// \param material_id The ID of the sphere's material in Materials()
+  void add(const Point3& center, Real radius, int material_id);
+
+  /// Append a copy of the sphere \p s to the set
+  void add(const Sphere& s);
+
+  /// Replace the contents of the set with \p count spheres given as
+  /// separate arrays, the layout the set itself uses. This is a bulk copy
+  /// with no per sphere work, meant for loading large scenes. The arrays
+  /// are double, as scene files are; a float build rounds them as it copies.
+  /// \param count The number of spheres
+  /// \param x The x coordinates of the centers
+  /// \param y The y coordinates of the centers
+  /// \param z The z coordinates of the centers
+  /// \param radius The radii
+  /// \param material_id The ID in Materials() of each sphere's material
+  void assign(int count, const double* x, const double* y, const double* z,
+              const double* radius, const int* material_id);
+
+  /// Return the number of spheres in the set
+  int size() const;
+
+  /// Return the center of sphere \p i
+  Point3 center(int i) const;
+
+  /// Return the radius of sphere \p i
+  Real radius(int i) const;
+
+  /// Return the box enclosing sphere \p i
+  AABB bounding_box(int i) const;
+
+  /// Return the ID in Materials() of sphere \p i's material
+  int material_id(int i) const;
+
+  /// Test the ray \p r against the \p count spheres starting at \p first
+  /// and record the closest hit between \p t_min and \p t_max in \p rec.
+  /// This is what a BVH leaf calls to test its spheres in one batch.
+  /// \param r The ray to check for intersection against
+  /// \param first The index of the first sphere to test
+  /// \param count The number of spheres to test
+  /// \param t_min The minimum value of the interval to test
+  /// \param t_max The maximum value of the interval to test
+  /// \param rec The HitRecord to store the data needed for shading
+  /// \returns true if the ray struck one of the spheres else false
+  bool hit(const Ray& r, int first, int count, Real t_min, Real t_max,
+           HitRecord& rec) const;
+
+  /// Check if any of the \p count spheres starting at \p first blocks the
+  /// ray \p r between its origin and \p t_max.
+  bool occluded(const Ray& r, int first, int count, Real t_max) const;
+
+  /// Test every ray of \p packet against the \p count spheres starting at
+  /// \p first. A lane's t_max is lowered to each closer hit and the index
+  /// of the sphere struck is stored in closest[lane]; lanes which strike
+  /// nothing keep their old values.
+  /// \param packet The rays to check for intersection against
+  /// \param first The index of the first sphere to test
+  /// \param count The number of spheres to test
+  /// \param t_min The minimum value of the interval to test
+  /// \param closest An array of kPacketSize sphere indices, one per lane
+  void hit_packet(RayPacket& packet, int first, int count, Real t_min,
+                  int* closest) const;
+
+  /// Fill \p rec with the hit of the ray \p r on sphere \p i at \p t
+  void record(const Ray& r, int i, Real t, HitRecord& rec) const;
+
+  /// Override the hittable hit() method by testing every sphere in the set.
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool hit(const Ray& r, Real t_min, Real t_max,
+           HitRecord& rec) const override;
+
+  /// Override the hittable occluded() method by testing every sphere in
+  /// the set.
+  /// \remarks This overrides the method defined in the Hittable class.
+  bool occluded(const Ray& r, Real t_max) const override;
+
+  /// Override the hittable bounding_box() method.
+  /// \returns The box enclosing every sphere in the set
+  /// \remarks This overrides the method defined in the Hittable class.
+  AABB bounding_box() const override;
+
+  /// Return the name of the intersection kernel in use: "avx2", "sse2", or
+  /// "scalar".
+  static std::string kernel_name();
+
+  /// Use the intersection kernel called \p name instead of the one picked
+  /// when the program started. This is meant for benchmarks and debugging.
+  /// \param name One of "avx2", "sse2", or "scalar"
+  /// \returns true if the kernel exists and the CPU supports it else false
+  static bool select_kernel(const std::string& name);
+};
+
+#endif
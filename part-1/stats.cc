@@ -0,0 +1,94 @@
+#include "stats.h"
+
+#include <fstream>
+#include <iomanip>
+
+// See the header file for documentation.
+
+namespace {
+// a / b, or 0 when b is 0.
+double Ratio(double a, double b) { return b > 0 ? a / b : 0.0; }
+}  // namespace
+
+RenderCounters& RenderCounters::operator+=(const RenderCounters& other) {
+  camera_rays += other.camera_rays;
+  shadow_rays += other.shadow_rays;
+  reflection_rays += other.reflection_rays;
+  hits += other.hits;
+  occlusions += other.occlusions;
+  box_tests += other.box_tests;
+  object_tests += other.object_tests;
+  shading_calls += other.shading_calls;
+  if (other.min_pixel_samples > 0) {
+    add_pixel(other.min_pixel_samples);
+    add_pixel(other.max_pixel_samples);
+  }
+  return *this;
+}
+
+void PrintStats(std::ostream& out, const FrameStats& stats) {
+  const RenderCounters& c = stats.render.counters;
+  double pixels = double(stats.width) * stats.height;
+  double rays = double(c.rays());
+  auto line = [&out](const char* name) -> std::ostream& {
+    return out << "  " << std::left << std::setw(16) << name << std::right;
+  };
+  std::ios::fmtflags flags = out.flags();
+  out << std::fixed << std::setprecision(4) << "Phases (seconds):\n";
+  line("scene") << std::setw(14) << stats.scene_seconds << "\n";
+  line("acceleration") << std::setw(14) << stats.acceleration_seconds << "\n";
+  line("render") << std::setw(14) << stats.render_seconds << "\n";
+  line("output") << std::setw(14) << stats.output_seconds << "\n";
+  out << std::setprecision(2) << "Counters:\n";
+  line("camera rays") << std::setw(14) << c.camera_rays << "\n";
+  line("shadow rays") << std::setw(14) << c.shadow_rays << "\n";
+  line("reflection rays") << std::setw(14) << c.reflection_rays << "\n";
+  line("rays") << std::setw(14) << c.rays() << "  "
+               << Ratio(rays, stats.render_seconds) / 1e6 << " M/s\n";
+  line("hits") << std::setw(14) << c.hits << "\n";
+  line("occlusions") << std::setw(14) << c.occlusions << "\n";
+  line("box tests") << std::setw(14) << c.box_tests << "  "
+                    << Ratio(double(c.box_tests), rays) << " per ray\n";
+  line("object tests") << std::setw(14) << c.object_tests << "  "
+                       << Ratio(double(c.object_tests), rays)
+                       << " per ray\n";
+  line("shading calls") << std::setw(14) << c.shading_calls << "\n";
+  line("samples") << std::setw(14) << stats.render.samples << "  "
+                  << Ratio(double(stats.render.samples), pixels)
+                  << " per pixel, " << c.min_pixel_samples << " to "
+                  << c.max_pixel_samples << "\n";
+  out.flags(flags);
+}
+
+bool WriteStatsJson(const std::string& file_name, const FrameStats& stats,
+                    std::string& error) {
+  std::ofstream out(file_name);
+  if (!out) {
+    error = "Could not create the statistics file " + file_name + ".";
+    return false;
+  }
+  const RenderCounters& c = stats.render.counters;
+  out << "{\n  \"width\": " << stats.width << ",\n  \"height\": "
+      << stats.height << ",\n  \"spheres\": " << stats.spheres
+      << ",\n  \"seconds\": {\"scene\": " << stats.scene_seconds
+      << ", \"acceleration\": " << stats.acceleration_seconds
+      << ", \"render\": " << stats.render_seconds
+      << ", \"output\": " << stats.output_seconds
+      << "},\n  \"counters\": {\"camera_rays\": " << c.camera_rays
+      << ", \"shadow_rays\": " << c.shadow_rays
+      << ", \"reflection_rays\": " << c.reflection_rays
+      << ", \"hits\": " << c.hits << ", \"occlusions\": " << c.occlusions
+      << ", \"box_tests\": " << c.box_tests
+      << ", \"object_tests\": " << c.object_tests
+      << ", \"shading_calls\": " << c.shading_calls
+      << "},\n  \"samples\": " << stats.render.samples
+      << ",\n  \"min_pixel_samples\": " << c.min_pixel_samples
+      << ",\n  \"max_pixel_samples\": " << c.max_pixel_samples
+      << ",\n  \"rays_per_second\": "
+      << Ratio(double(c.rays()), stats.render_seconds) << "\n}\n";
+  if (!out) {
+    error = "Could not write the statistics file " + file_name + ".";
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,111 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <ostream>
+#include <string>
+
+/// Counts of the work done while rendering.
+///
+/// Every thread counts into its own RenderCounters, returned by
+/// ThreadCounters(), so counting is a plain increment with no atomics and
+/// no sharing of cache lines between threads. The BVH and the Grid keep
+/// their counts of box and object tests in a TraversalCounts while they
+/// walk and add them to the thread's counters once per ray. Render() adds
+/// up the threads' counters after every tile.
+struct RenderCounters {
+  /// Rays traced from the camera, one per sample
+  long long camera_rays = 0;
+  /// Rays traced toward a light to see whether it is blocked
+  long long shadow_rays = 0;
+  /// Rays traced in the mirror direction from a reflective surface
+  long long reflection_rays = 0;
+  /// Camera and reflection rays which struck something
+  long long hits = 0;
+  /// Shadow rays which were blocked
+  long long occlusions = 0;
+  /// Tests of a ray, or of a packet of rays, against a BVH node's box, and
+  /// grid cells visited
+  long long box_tests = 0;
+  /// Tests of a ray, or of a packet of rays, against an object
+  long long object_tests = 0;
+  /// Hits shaded with the Phong model
+  long long shading_calls = 0;
+  /// The fewest and the most samples taken through one pixel; 0 when no
+  /// pixel has been finished
+  int min_pixel_samples = 0;
+  int max_pixel_samples = 0;
+
+  /// Add the counts of \p other to these. The pixel sample extremes are
+  /// combined by taking the smaller minimum and the larger maximum.
+  RenderCounters& operator+=(const RenderCounters& other);
+
+  /// Record that a pixel was finished with \p samples samples.
+  void add_pixel(int samples) {
+    if (min_pixel_samples == 0 || samples < min_pixel_samples) {
+      min_pixel_samples = samples;
+    }
+    if (samples > max_pixel_samples) {
+      max_pixel_samples = samples;
+    }
+  }
+
+  /// Return the number of rays of every kind
+  long long rays() const {
+    return camera_rays + shadow_rays + reflection_rays;
+  }
+};
+
+/// Return the calling thread's counters.
+inline RenderCounters& ThreadCounters() {
+  thread_local RenderCounters counters;
+  return counters;
+}
+
+/// The tests made by one walk of an acceleration structure, counted in
+/// locals and added to the thread's counters when the walk ends.
+struct TraversalCounts {
+  long long box_tests = 0;
+  long long object_tests = 0;
+  ~TraversalCounts() {
+    RenderCounters& counters = ThreadCounters();
+    counters.box_tests += box_tests;
+    counters.object_tests += object_tests;
+  }
+};
+
+/// Figures gathered while rendering an image.
+struct RenderStats {
+  /// The number of samples (camera rays) taken over the whole image
+  long long samples = 0;
+  /// The work done by every thread, added up
+  RenderCounters counters;
+};
+
+/// Where the time making one frame went, and what was done.
+struct FrameStats {
+  /// The width and height of the image in pixels
+  int width = 0;
+  int height = 0;
+  /// The number of spheres in the scene
+  int spheres = 0;
+  /// The seconds spent loading or generating the scene
+  double scene_seconds = 0.0;
+  /// The seconds spent building the BVH
+  double acceleration_seconds = 0.0;
+  /// The seconds spent rendering
+  double render_seconds = 0.0;
+  /// The seconds spent writing the image file
+  double output_seconds = 0.0;
+  /// The figures returned by Render()
+  RenderStats render;
+};
+
+/// Print \p stats to \p out as a table for people to read.
+void PrintStats(std::ostream& out, const FrameStats& stats);
+
+/// Write \p stats to \p file_name as a JSON object.
+/// \returns true on success else false with a description in \p error
+bool WriteStatsJson(const std::string& file_name, const FrameStats& stats,
+                    std::string& error);
+
+#endif
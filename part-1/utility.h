@@ -41,12 +41,19 @@ double Square(double x);
 /// \returns the number of radians
 double DegreesToRadians(double degrees);
 
-/// Create a random scene of many spheres
+/// Create a random scene of many spheres: the five spheres of FiveSpheres()
+/// and \p num_elements small spheres drawn from the calling thread's random
+/// number engine. Each sphere is a separate object; GenerateRandomScene()
+/// makes the same kind of scene much faster when only a Scene is needed.
 /// \param num_elements The number of randomly created elements to place
 /// in the scene
 /// \returns A vector of hittable elements
 std::vector<std::shared_ptr<Hittable>> RandomScene(int num_elements);
 
+/// Append five large spheres, in plain red, green, blue, yellow and purple,
+/// which mark the middle and the edges of the default view to \p world.
+void FiveSpheres(std::vector<std::shared_ptr<Hittable>>& world);
+
 /// Return a vector with one yellow sphere that is floating in front of
 /// the camera similar to lab 11.
 /// \returns a vector of hittable objects which in this case only has one
@@ -59,16 +66,14 @@ std::vector<std::shared_ptr<Hittable>> OriginalScene();
 /// were taken from Mark Kilgard's
 /// [teapots.c]
 /// (https://www.opengl.org/archives/resources/code/samples/redbook/teapots.c)
-/// program.
+/// program. The materials are only created once; every call returns the
+/// same handles into the material table.
 std::array<std::shared_ptr<PhongMaterial>, 29> make_phong_material_array();
 
 /// Return a map (or dictionary) of PhongMaterial objects.
 /// This utility function is useful to lookup material properties when
-/// only the name of the material is known. The materials were taken from
-/// Mark Kilgard's
-/// [teapots.c]
-/// (https://www.opengl.org/archives/resources/code/samples/redbook/teapots.c)
-/// program.
+/// only the name of the material is known. It holds the same materials as
+/// make_phong_material_array().
 std::map<std::string, std::shared_ptr<PhongMaterial>> make_phong_material_map();
 
 #endif
\ No newline at end of file
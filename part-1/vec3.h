@@ -1,92 +1,133 @@
-
 #ifndef _VEC3_H_
 #define _VEC3_H_
 
 #include <cmath>
 #include <iostream>
 
+#include "real.h"
 #include "rng.h"
 
 /// A 3 dimensional vector class to represent vectors, points, and colors
+///
+/// Vec3 arithmetic is the inner loop of every ray so all of it is defined
+/// right here in the header as inline (and, where the math allows it,
+/// constexpr) functions. That way the compiler can inline it into
+/// Sphere::hit(), PhongMaterial::reflect_color(), and the sampling loop
+/// without link time optimization.
 class Vec3 {
  private:
-  // This is a fancy trick (from the days of C) to say that we have
-  // three doubles named x_, y_, and z_ and we can also refer to the
-  // very same variables as r_, g_, and b_, and as the C array data_.
-  // Be careful with this little trick.
-  // We should all really use C++ 17's std::variant
-  // https://en.cppreference.com/w/cpp/utility/variant
-  union {
-    struct {
-      double x_, y_, z_;
-    };
-    struct {
-      double r_, g_, b_;
-    };
-    struct {
-      double data_[3];
-    };
-  };
+  // The three components live in a C array so that operator[] is a plain
+  // array access. x(), y(), and z() name the same values as r(), g(),
+  // and b() when the Vec3 is used as a color.
+  Real data_[3];
 
  public:
   /// The default constructor for Vec3 creates a Vec3 initialized
   /// to a zero vector.
-  Vec3() : x_{0.0}, y_{0.0}, z_{0.0} {};
+  constexpr Vec3() : data_{0.0, 0.0, 0.0} {};
 
   /// Constructor to initialize a Vec3 with \p x, \p y, and \p z.
-  Vec3(double x, double y, double z) : x_{x}, y_{y}, z_{z} {};
+  /// The arguments are double so that a Vec3 can be brace initialized from
+  /// doubles in either precision; they are rounded to Real.
+  constexpr Vec3(double x, double y, double z)
+      : data_{Real(x), Real(y), Real(z)} {};
 
   /// Return the value of x
-  /// \returns the value of x_
-  double x() const;
+  /// \returns the x component
+  constexpr Real x() const { return data_[0]; }
 
   /// Return the value of y
-  /// \returns the value of y_
-  double y() const;
+  /// \returns the y component
+  constexpr Real y() const { return data_[1]; }
 
   /// Return the value of z
-  /// \returns the value of z_
-  double z() const;
+  /// \returns the z component
+  constexpr Real z() const { return data_[2]; }
 
   /// Return the value of r
-  /// \returns the value of r_
-  double r() const;
+  /// \returns the r component
+  constexpr Real r() const { return data_[0]; }
 
   /// Return the value of g
-  /// \returns the value of g_
-  double g() const;
+  /// \returns the g component
+  constexpr Real g() const { return data_[1]; }
 
   /// Return the value of b
-  /// \returns the value of b_
-  double b() const;
+  /// \returns the b component
+  constexpr Real b() const { return data_[2]; }
 
   /// Negation operator
   /// \returns a copy of *this negated.
-  Vec3 operator-() const;
+  constexpr Vec3 operator-() const {
+    return Vec3{-data_[0], -data_[1], -data_[2]};
+  }
 
   /// Operator [] which allows the object to be treated like a
   /// a C array. This is a const version so it can only be used for reading.
   /// Vec3 foo{1, 2, 3};
   /// double val = foo[1];
-  double operator[](int i) const;
+  constexpr Real operator[](int i) const { return data_[i]; }
   /// Operator [] which allows the object to be treated like a
   /// a C array. This is a non-const version which returns a reference
   /// so it can be used for writing.
   /// Vec3 foo{1, 2, 3};
   /// foo[1] = 42;
-  double& operator[](int i);
+  constexpr Real& operator[](int i) { return data_[i]; }
+
+  /// Add \p v to this vector
+  /// \returns a reference to *this
+  constexpr Vec3& operator+=(const Vec3& v) {
+    data_[0] += v.data_[0];
+    data_[1] += v.data_[1];
+    data_[2] += v.data_[2];
+    return *this;
+  }
+
+  /// Subtract \p v from this vector
+  /// \returns a reference to *this
+  constexpr Vec3& operator-=(const Vec3& v) {
+    data_[0] -= v.data_[0];
+    data_[1] -= v.data_[1];
+    data_[2] -= v.data_[2];
+    return *this;
+  }
+
+  /// Scale this vector by \p t
+  /// \returns a reference to *this
+  constexpr Vec3& operator*=(Real t) {
+    data_[0] *= t;
+    data_[1] *= t;
+    data_[2] *= t;
+    return *this;
+  }
+
+  /// Multiply the components of this color by the components of \p v
+  /// \returns a reference to *this
+  /// \remark This is not used for Vectors!
+  constexpr Vec3& operator*=(const Vec3& v) {
+    data_[0] *= v.data_[0];
+    data_[1] *= v.data_[1];
+    data_[2] *= v.data_[2];
+    return *this;
+  }
+
+  /// Scale this vector by 1 / \p t
+  /// \returns a reference to *this
+  constexpr Vec3& operator/=(Real t) { return *this *= Real(1) / t; }
 
   /// Calculate the length of a vector using the distance formula.
   /// d = sqrt(x*x + y*y + z*z)
   /// \returns the length of the vector
-  double length() const;
+  Real length() const { return std::sqrt(length_squared()); }
 
   /// Calculate the squared length of a vector using the distance formula.
   /// This is fast and useful when one wants to compare relative distances
   /// or when you wish to determine if a vector is of unit length.
   /// d = x*x + y*y + z*z
   /// \returns the squared length of the vector
-  double length_squared() const;
+  constexpr Real length_squared() const {
+    return data_[0] * data_[0] + data_[1] * data_[1] + data_[2] * data_[2];
+  }
 
   /// Return a Vec3 with each component set to a random value between 0 and 1
   static Vec3 random_01();
@@ -103,27 +144,33 @@ class Vec3 {
 /// \param u The left hand operand of the operator
 /// \param v The right hand operand of the operator
 /// \returns The sum of \p u and \p v as a new Vec3.
-Vec3 operator+(const Vec3& u, const Vec3& v);
+constexpr Vec3 operator+(const Vec3& u, const Vec3& v) {
+  return Vec3{u.x() + v.x(), u.y() + v.y(), u.z() + v.z()};
+}
 
 /// Difference of \p u and \p v together
 /// \param u The left hand operand of the operator
 /// \param v The right hand operand of the operator
 /// \returns The difference of \p u and \p v as a new Vec3.
-Vec3 operator-(const Vec3& u, const Vec3& v);
+constexpr Vec3 operator-(const Vec3& u, const Vec3& v) {
+  return Vec3{u.x() - v.x(), u.y() - v.y(), u.z() - v.z()};
+}
 
 /// Product of \p t and \p v
 /// Where \p t is a scalar value and \p v is a Vec3, scale \p v with \p t.
 /// \param t The left hand operand of the operator
 /// \param v The right hand operand of the operator
 /// \returns The product of \p t and \p v as a new Vec3.
-Vec3 operator*(double t, const Vec3& v);
+constexpr Vec3 operator*(Real t, const Vec3& v) {
+  return Vec3{t * v.x(), t * v.y(), t * v.z()};
+}
 
 /// Product of \p v and \p t
 /// Where \p t is a scalar value and \p v is a Vec3, scale \p v with \p t.
 /// \param v The left hand operand of the operator
 /// \param t The right hand operand of the operator
 /// \returns The product of \p t and \p v as a new Vec3.
-Vec3 operator*(const Vec3& v, double t);
+constexpr Vec3 operator*(const Vec3& v, Real t) { return t * v; }
 
 /// Product of \p u and \p v - this operation is for Color not Vectors!
 /// Multiply the components of \p u with the components of \p v and
@@ -132,14 +179,16 @@ Vec3 operator*(const Vec3& v, double t);
 /// \param v The right hand operand of the operator
 /// \returns The product of \p u and \p v as a Vec3
 /// \remark This is not used for Vectors!
-Vec3 operator*(const Vec3& u, const Vec3& v);
+constexpr Vec3 operator*(const Vec3& u, const Vec3& v) {
+  return Vec3{u.x() * v.x(), u.y() * v.y(), u.z() * v.z()};
+}
 
 /// Quotient of \p v and \p t
 /// Where \p t is a scalar value and \p v is a Vec3, scale \p v with 1/t.
 /// \param v The left hand operand of the operator
 /// \param t The right hand operand of the operator
 /// \returns The product of \p t and \p v as a new Vec3.
-Vec3 operator/(const Vec3& v, double t);
+constexpr Vec3 operator/(const Vec3& v, Real t) { return (Real(1) / t) * v; }
 
 /// The dot product of two Vec3 objects.
 /// The [dot product](https://en.wikipedia.org/wiki/Dot_product) is
@@ -148,28 +197,40 @@ Vec3 operator/(const Vec3& v, double t);
 /// \param u The left hand operand of the operator
 /// \param v The right hand operand of the operator
 /// \returns The dot product between u and v.
-double Dot(const Vec3& u, const Vec3& v);
+constexpr Real Dot(const Vec3& u, const Vec3& v) {
+  return u.x() * v.x() + u.y() * v.y() + u.z() * v.z();
+}
 
 /// The cross product of two Vec3 objects.
 /// The cross product of two vectors yields a third which is mutally
 /// orthogonal to the first two.
 // \param u The first vector.
 // \param v The second vector.
-Vec3 Cross(const Vec3& u, const Vec3& v);
+constexpr Vec3 Cross(const Vec3& u, const Vec3& v) {
+  return Vec3{u.y() * v.z() - u.z() * v.y(), u.z() * v.x() - u.x() * v.z(),
+              u.x() * v.y() - u.y() * v.x()};
+}
 
 /// Return a unit length (length == 1.0) vector given the vector \p v.
+/// The reciprocal of the length is computed once, with a single square
+/// root and division, and the three components are multiplied by it.
 /// \param v The vector to be resized to unit length
 /// \returns A vector of unit length
 /// \remark This function does not handle degenerate cases where the vector's
 /// length is 0.
-Vec3 UnitVector(const Vec3& v);
+inline Vec3 UnitVector(const Vec3& v) {
+  Real inverse_length = Real(1) / std::sqrt(v.length_squared());
+  return inverse_length * v;
+}
 
 /// Return the reflected vector given the normal \p n and the incoming
 /// direction vector \p v.
 /// \param v The incoming vector direction
 /// \param n The normal to the surface
 /// \returns the reflection vector
-Vec3 Reflect(const Vec3& v, const Vec3& n);
+constexpr Vec3 Reflect(const Vec3& v, const Vec3& n) {
+  return (2 * Dot(v, n) * n) - v;
+}
 
 /// Convert a Vec3 object into a string so it can be printed.
 /// This is a function which defines a new behavior for the << operator.
@@ -194,4 +255,4 @@ using Point3 = Vec3;
 /// same thing as Vec3. (Be warned that mathematically a 3 channel color is
 /// not the same thing as a 3D vector.)
 using Color = Vec3;
-#endif
\ No newline at end of file
+#endif